@@ -67,365 +67,2443 @@
 #define OLC_PGEX_TRANSFORMEDVIEW
 #include "olcPGEX_TransformedView.h"
 
-#include <unordered_set>
+#include <unordered_map>
+#include <optional>
 #include <vector>
 #include <cmath>
 #include <random>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <typeinfo>
 #include <string>
 #include <limits>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include <utility>
+#include <cstdio>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#if defined(_WIN32)
 #include "wtypes.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Built with -DSIM_COUNT_ALLOCATIONS, every global operator new bumps a counter,
+// which --check-allocations reads around each tick.
+#ifdef SIM_COUNT_ALLOCATIONS
+std::atomic<uint64_t> allocationCount{0};
+
+// Unaligned new and delete all go through this pair. Both are kept out of line, or
+// GCC inlines malloc and free into their callers and warns that new and delete don't match.
+#if defined(_MSC_VER)
+#define SIM_NOINLINE __declspec(noinline)
+#else
+#define SIM_NOINLINE __attribute__((noinline))
+#endif
+SIM_NOINLINE void* countedAllocate(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if(void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+SIM_NOINLINE void countedFree(void* p) noexcept { std::free(p); }
+#undef SIM_NOINLINE
+
+void* operator new(size_t size) { return countedAllocate(size); }
+void* operator new[](size_t size) { return countedAllocate(size); }
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	size_t align = static_cast<size_t>(alignment);
+#if defined(_WIN32)
+	void* p = _aligned_malloc(size ? size : 1, align);
+#else
+	void* p = std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+	if(p) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+
+#if defined(_WIN32)
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+#endif
+void operator delete[](void* p, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+#endif
+
+// used for the world size when there is no desktop to measure, e.g. headless runs on Linux
+int const DEFAULT_SCREEN_WIDTH = 1920;
+int const DEFAULT_SCREEN_HEIGHT = 1080;
+// a cell is 10 x 10 pixels in the app, so this is its world on the default screen
+int const DEFAULT_WORLD_WIDTH = (DEFAULT_SCREEN_WIDTH + 9) / 10;
+int const DEFAULT_WORLD_HEIGHT = (DEFAULT_SCREEN_HEIGHT + 9) / 10;
+
+// a fresh seed for runs that weren't given one
+uint64_t randomSeed() {
+	std::random_device rd;
+	return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+// SplitMix64's finalizer: every input bit flips about half of the output bits
+uint64_t mix64(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ull;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBull;
+	x ^= x >> 31;
+	return x;
+}
+
+// What a random draw is used for, so that one agent's draws for different
+// decisions in the same tick come from unrelated streams.
+enum class RngPurpose : uint32_t {
+	PREY_MOVE,
+	PREY_REPRODUCE,
+	PREDATOR_MOVE,
+	PREDATOR_REPRODUCE
+};
+
+// Counter-based generator (Philox4x32-10, Salmon et al. 2011). Every number is a
+// pure function of (seed, tick, agent id, purpose, draw index), so agents can be
+// updated in any order and on any thread and still draw exactly the same values.
+// There is no state to share; a generator is made on the stack for each decision.
+class AgentRng {
+public:
+	AgentRng(uint64_t seed, uint64_t tick, uint64_t agentId, RngPurpose purpose) :
+		key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+		counter{static_cast<uint32_t>(purpose) << 24,
+			static_cast<uint32_t>(tick),
+			static_cast<uint32_t>(agentId),
+			static_cast<uint32_t>((agentId >> 32) & 0xffff) | static_cast<uint32_t>((tick >> 32) << 16)} {}
+
+	uint32_t next() {
+		if(used == 4) {
+			refill();
+		}
+		return block[used++];
+	}
+
+	// uniform in [lo, hi]
+	int uniformInt(int lo, int hi) {
+		uint32_t range = static_cast<uint32_t>(hi - lo) + 1;
+		return lo + static_cast<int>((static_cast<uint64_t>(next()) * range) >> 32);
+	}
+
+	// uniform in [0, 1)
+	float uniform01() {
+		return (next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+private:
+	void refill() {
+		uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+		uint32_t k[2] = {key[0], key[1]};
+		for(int round = 0; round < 10; round++) {
+			if(round > 0) {
+				k[0] += 0x9E3779B9;
+				k[1] += 0xBB67AE85;
+			}
+			uint64_t p0 = static_cast<uint64_t>(0xD2511F53) * c[0];
+			uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57) * c[2];
+			uint32_t next0 = static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0];
+			uint32_t next2 = static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1];
+			c[0] = next0;
+			c[1] = static_cast<uint32_t>(p1);
+			c[2] = next2;
+			c[3] = static_cast<uint32_t>(p0);
+		}
+		for(int i = 0; i < 4; i++) {
+			block[i] = c[i];
+		}
+		used = 0;
+		// the low 24 bits of the first word count blocks, the top 8 hold the purpose
+		counter[0]++;
+	}
+
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t block[4] = {0, 0, 0, 0};
+	int used = 4;
+};
+
+// Hands out memory aligned to a cache line, so per-cell arrays start on one.
+template <typename T, size_t ALIGNMENT = 64>
+struct AlignedAllocator {
+	using value_type = T;
+
+	template <typename U>
+	struct rebind { using other = AlignedAllocator<U, ALIGNMENT>; };
+
+	AlignedAllocator() = default;
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT))); }
+	void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(ALIGNMENT)); }
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, ALIGNMENT>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// A width x height array in one cache-line aligned buffer, stored row by row.
+// Every row starts on a cache line, so rows are stride cells apart rather than
+// width. An optional border of padding cells on every side can be read like
+// any other cell, which lets neighbourhood kernels look one step past the edge
+// without bounds checks. A grid can also view cells someone else holds, such as a
+// mapped terrain cache, which it then only reads.
+template <typename T>
+class Grid2D {
+public:
+	Grid2D() = default;
+
+	Grid2D(int gridWidth, int gridHeight, T fill = T(), int border = 0) { reset(gridWidth, gridHeight, fill, border); }
+
+	Grid2D(const Grid2D& other) { *this = other; }
+
+	Grid2D& operator=(const Grid2D& other) {
+		copyLayout(other);
+		cells = other.cells;
+		base = other.isView() ? other.base : cells.data();
+		return *this;
+	}
+
+	Grid2D(Grid2D&& other) noexcept { *this = std::move(other); }
+
+	Grid2D& operator=(Grid2D&& other) noexcept {
+		copyLayout(other);
+		bool otherIsView = other.isView();
+		cells = std::move(other.cells);
+		base = otherIsView ? other.base : cells.data();
+		other.base = other.cells.data();
+		return *this;
+	}
+
+	// resizes the grid and sets every cell, border included, to fill
+	void reset(int gridWidth, int gridHeight, T fill = T(), int border = 0) {
+		layout(gridWidth, gridHeight, border);
+		cells.assign(bufferCells(), fill);
+		base = cells.data();
+	}
+
+	// Reads the cells from a buffer laid out the way reset() lays them out, as
+	// written by data() and sizeBytes(). The buffer must outlive the view, and
+	// the grid must not be written to until the next reset().
+	void view(const T* buffer, int gridWidth, int gridHeight, int border = 0) {
+		layout(gridWidth, gridHeight, border);
+		cells = AlignedVector<T>();
+		base = const_cast<T*>(buffer);
+	}
+
+	bool isView() const { return base != nullptr && base != cells.data(); }
+
+	// what sizeBytes() will be after reset(gridWidth, gridHeight, fill, border)
+	static size_t layoutBytes(int gridWidth, int gridHeight, int border = 0) {
+		return static_cast<size_t>(strideFor(gridWidth, border)) * (gridHeight + 2 * border) * sizeof(T);
+	}
+
+	// the whole buffer, border and row padding included
+	const T* data() const { return base; }
+
+	int getWidth() const { return width; }
+
+	int getHeight() const { return height; }
+
+	int getStride() const { return stride; }
+
+	int getPadding() const { return padding; }
+
+	// memory held by the cells, border and row padding included
+	size_t sizeBytes() const { return bufferCells() * sizeof(T); }
+
+	// inside the grid proper, not the border
+	bool inBounds(olc::vi2d cell) const { return cell.x >= 0 && cell.y >= 0 && cell.x < width && cell.y < height; }
+
+	// x and y may reach padding cells past either edge
+	T& operator()(int x, int y) { return base[index(x, y)]; }
+	const T& operator()(int x, int y) const { return base[index(x, y)]; }
+
+	T& operator[](olc::vi2d cell) { return base[index(cell.x, cell.y)]; }
+	const T& operator[](olc::vi2d cell) const { return base[index(cell.x, cell.y)]; }
+
+	// the first cell of row y, with row(y)[x] == (*this)(x, y)
+	T* row(int y) { return &base[index(0, y)]; }
+	const T* row(int y) const { return &base[index(0, y)]; }
+
+private:
+	size_t index(int x, int y) const { return origin + static_cast<ptrdiff_t>(y) * stride + x; }
+
+	void layout(int gridWidth, int gridHeight, int border) {
+		width = gridWidth;
+		height = gridHeight;
+		padding = border;
+		stride = strideFor(width, padding);
+		origin = static_cast<size_t>(padding) * stride + padding;
+	}
+
+	// rows start on a cache line when T packs into one evenly
+	static int strideFor(int gridWidth, int border) {
+		size_t perLine = 64 % sizeof(T) == 0 ? 64 / sizeof(T) : 1;
+		return static_cast<int>((gridWidth + 2 * border + perLine - 1) / perLine * perLine);
+	}
+
+	void copyLayout(const Grid2D& other) {
+		width = other.width;
+		height = other.height;
+		stride = other.stride;
+		padding = other.padding;
+		origin = other.origin;
+	}
+
+	size_t bufferCells() const { return static_cast<size_t>(stride) * (height + 2 * padding); }
+
+	int width = 0;
+	int height = 0;
+	int stride = 0;
+	int padding = 0;
+	// where cell (0, 0) sits in the buffer, past the top border and the left one
+	size_t origin = 0;
+	AlignedVector<T> cells;
+	// cells.data(), or the buffer the grid views
+	T* base = nullptr;
+};
+
+// Colours packed as r | g << 8 | b << 16, alpha dropped since camouflage ignores it.
+inline uint32_t packColor(olc::Pixel color) {
+	return color.r | (color.g << 8) | (color.b << 16);
+}
+
+// How different two colours look: the mean absolute difference over r, g and b, rounded down.
+inline int packedColorDiff(uint32_t a, uint32_t b) {
+	int dr = std::abs(static_cast<int>(a & 0xff) - static_cast<int>(b & 0xff));
+	int dg = std::abs(static_cast<int>((a >> 8) & 0xff) - static_cast<int>((b >> 8) & 0xff));
+	int db = std::abs(static_cast<int>((a >> 16) & 0xff) - static_cast<int>((b >> 16) & 0xff));
+	return (dr + dg + db) / 3;
+}
+
+// packedColorDiff of one colour against a batch of colours. The loop is plain
+// integer math with no branches, so the compiler vectorises it.
+inline void packedColorDiffs(uint32_t color, const uint32_t* colors, int* diffs, int count) {
+	for(int i=0; i<count; i++) {
+		diffs[i] = packedColorDiff(color, colors[i]);
+	}
+}
+
+// A cell a predator can see, relative to the predator.
+struct SightOffset {
+	int dx;
+	int dy;
+};
+
+constexpr bool inSight(int dx, int dy, int radius) {
+	return dx*dx + dy*dy <= radius*radius + 3;
+}
+
+constexpr int sightCellCount(int radius) {
+	int count = 0;
+	for(int dy=-radius; dy<=radius; dy++) {
+		for(int dx=-radius; dx<=radius; dx++) {
+			if(inSight(dx, dy, radius)) count++;
+		}
+	}
+	return count;
+}
+
+// Every offset within sight, built at compile time in the row-by-row order a scan
+// of the bounding box visits them, so a predator only walks the disk itself.
+template <int RADIUS>
+constexpr std::array<SightOffset, sightCellCount(RADIUS)> makeSightDisk() {
+	std::array<SightOffset, sightCellCount(RADIUS)> disk{};
+	int next = 0;
+	for(int dy=-RADIUS; dy<=RADIUS; dy++) {
+		for(int dx=-RADIUS; dx<=RADIUS; dx++) {
+			if(inSight(dx, dy, RADIUS)) disk[next++] = SightOffset{dx, dy};
+		}
+	}
+	return disk;
+}
+
+// Which store an agent lives in; the occupancy grid keeps it with every entry.
+enum class Species : uint8_t {
+	PREY,
+	PREDATOR
+};
+
+// How a store's agent slots are used, for capacity planning. The columns are a
+// pool of slots: a birth takes a slot some dead agent left behind (recycled) or
+// grows the pool past its peak.
+struct SlotStats {
+	size_t live = 0;
+	size_t peak = 0;
+	size_t capacity = 0;
+	uint64_t births = 0;
+	uint64_t deaths = 0;
+	uint64_t recycled = 0;
+};
+
+// Checkpoints are a run of blocks, each its length in bytes and then the bytes,
+// so a column goes out and comes back in with one write and one read.
+inline void writeBlock(std::ostream& out, const void* bytes, uint64_t length) {
+	out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(length));
+}
+
+// false unless the next block is exactly length bytes
+inline bool readBlock(std::istream& in, void* bytes, uint64_t length) {
+	uint64_t stored = 0;
+	if(!in.read(reinterpret_cast<char*>(&stored), sizeof(stored)) || stored != length) return false;
+	return static_cast<bool>(in.read(static_cast<char*>(bytes), static_cast<std::streamsize>(length)));
+}
+
+template <typename T>
+void writeColumn(std::ostream& out, const std::vector<T>& column) {
+	static_assert(std::is_trivially_copyable_v<T>, "columns are written byte for byte");
+	writeBlock(out, column.data(), column.size() * sizeof(T));
+}
+
+// how much of a file stream is still to be read
+inline uint64_t bytesLeft(std::istream& in) {
+	std::streampos here = in.tellg();
+	if(here < 0) return 0;
+	in.seekg(0, std::ios::end);
+	std::streampos end = in.tellg();
+	in.seekg(here);
+	return end > here ? static_cast<uint64_t>(end - here) : 0;
+}
+
+// reads a column of count values; false, without allocating, when a damaged
+// count asks for more values than the rest of the file holds
+template <typename T>
+bool readColumn(std::istream& in, std::vector<T>& column, size_t count) {
+	static_assert(std::is_trivially_copyable_v<T>, "columns are read byte for byte");
+	if(count > bytesLeft(in) / sizeof(T)) return false;
+	column.resize(count);
+	return readBlock(in, column.data(), count * sizeof(T));
+}
+
+// Column storage shared by every species: agent i is element i of each column.
+// Dead agents are swap-removed so the columns stay dense and the update loops walk them in order.
+struct AgentStore {
+	// unique for the lifetime of the simulation and never reused, unlike the index
+	std::vector<uint64_t> id;
+	std::vector<olc::vi2d> pos;
+	std::vector<olc::vi2d> prevPos;
+	std::vector<olc::Pixel> color;
+	std::vector<int> itersSinceRepro;
+	std::vector<uint8_t> alive;
+
+	size_t size() const { return pos.size(); }
+
+	// agents the columns hold before they need to grow; slots freed by dead agents are reused
+	size_t capacity() const { return pos.capacity(); }
+
+	SlotStats slotStats() const {
+		SlotStats stats = slots;
+		stats.live = size();
+		stats.capacity = capacity();
+		return stats;
+	}
+
+	protected:
+	// the agent count, the slot statistics, then a block per column
+	void writeColumns(std::ostream& out) const {
+		uint64_t count = size();
+		writeBlock(out, &count, sizeof(count));
+		writeBlock(out, &slots, sizeof(slots));
+		writeColumn(out, id);
+		writeColumn(out, pos);
+		writeColumn(out, prevPos);
+		writeColumn(out, color);
+		writeColumn(out, itersSinceRepro);
+		writeColumn(out, alive);
+	}
+
+	// reads what writeColumns() wrote, leaving the agent count in count
+	bool readColumns(std::istream& in, size_t& count) {
+		uint64_t stored = 0;
+		if(!readBlock(in, &stored, sizeof(stored)) || !readBlock(in, &slots, sizeof(slots))) return false;
+		count = static_cast<size_t>(stored);
+		return readColumn(in, id, count) && readColumn(in, pos, count) && readColumn(in, prevPos, count) &&
+			readColumn(in, color, count) && readColumn(in, itersSinceRepro, count) && readColumn(in, alive, count);
+	}
+
+	// grows every column to hold count agents, so births up to there never allocate
+	void reserveColumns(size_t count) {
+		id.reserve(count);
+		pos.reserve(count);
+		prevPos.reserve(count);
+		color.reserve(count);
+		itersSinceRepro.reserve(count);
+		alive.reserve(count);
+	}
+
+	size_t push(uint64_t newId, olc::vi2d newPos, olc::Pixel newColor) {
+		slots.births++;
+		if(size() < slots.peak) {
+			slots.recycled++;
+		}
+		slots.peak = std::max(slots.peak, size() + 1);
+		id.push_back(newId);
+		pos.push_back(newPos);
+		prevPos.push_back(newPos);
+		color.push_back(newColor);
+		itersSinceRepro.push_back(0);
+		alive.push_back(1);
+		return pos.size() - 1;
+	}
+
+	// overwrites agent `to` with agent `from`
+	void copyAgent(size_t from, size_t to) {
+		id[to] = id[from];
+		pos[to] = pos[from];
+		prevPos[to] = prevPos[from];
+		color[to] = color[from];
+		itersSinceRepro[to] = itersSinceRepro[from];
+		alive[to] = alive[from];
+	}
+
+	void popBack() {
+		slots.deaths++;
+		id.pop_back();
+		pos.pop_back();
+		prevPos.pop_back();
+		color.pop_back();
+		itersSinceRepro.pop_back();
+		alive.pop_back();
+	}
+
+	// the columns hold plain values, so this only resets their ends and keeps every slot
+	void clearColumns() {
+		id.clear();
+		pos.clear();
+		prevPos.clear();
+		color.clear();
+		itersSinceRepro.clear();
+		alive.clear();
+	}
+
+	SlotStats slots;
+};
+
+struct PredatorStore : AgentStore {
+	static constexpr Species SPECIES = Species::PREDATOR;
+
+	std::vector<int> itersSinceFood;
+	// a predator starves once it has gone longer than this without eating
+	int starvation = 35;
+
+	// one tick older for predators [begin, end): hungrier, and dead if starved;
+	// plain loops over the columns, so the compiler can vectorise them
+	void age(size_t begin, size_t end) {
+		for(size_t i = begin; i < end; i++) {
+			itersSinceFood[i]++;
+			itersSinceRepro[i]++;
+			alive[i] = itersSinceFood[i] <= starvation;
+		}
+	}
+
+	size_t add(uint64_t newId, olc::vi2d newPos, olc::Pixel newColor) {
+		itersSinceFood.push_back(0);
+		return push(newId, newPos, newColor);
+	}
+
+	// the last predator takes the place of the removed one
+	void swapRemove(size_t index) {
+		size_t last = size() - 1;
+		if(index != last) {
+			copyAgent(last, index);
+			itersSinceFood[index] = itersSinceFood[last];
+		}
+		popBack();
+		itersSinceFood.pop_back();
+	}
+
+	void reserve(size_t count) {
+		reserveColumns(count);
+		itersSinceFood.reserve(count);
+	}
+
+	// drops every predator at once, keeping the slots for the next world
+	void clear() {
+		clearColumns();
+		itersSinceFood.clear();
+	}
+
+	void write(std::ostream& out) const {
+		writeColumns(out);
+		writeColumn(out, itersSinceFood);
+	}
+
+	bool read(std::istream& in) {
+		size_t count = 0;
+		return readColumns(in, count) && readColumn(in, itersSinceFood, count);
+	}
+};
+
+struct PreyStore : AgentStore {
+	static constexpr Species SPECIES = Species::PREY;
+
+	std::vector<int> itersAlive;
+	// a prey dies of old age once it has lived longer than this
+	int lifespan = 26;
+
+	// one tick older for preys [begin, end), and dead if past their lifespan
+	void age(size_t begin, size_t end) {
+		for(size_t i = begin; i < end; i++) {
+			itersSinceRepro[i]++;
+			itersAlive[i]++;
+			alive[i] = itersAlive[i] <= lifespan;
+		}
+	}
+
+	size_t add(uint64_t newId, olc::vi2d newPos, olc::Pixel newColor) {
+		itersAlive.push_back(0);
+		return push(newId, newPos, newColor);
+	}
+
+	// the last prey takes the place of the removed one
+	void swapRemove(size_t index) {
+		size_t last = size() - 1;
+		if(index != last) {
+			copyAgent(last, index);
+			itersAlive[index] = itersAlive[last];
+		}
+		popBack();
+		itersAlive.pop_back();
+	}
+
+	void reserve(size_t count) {
+		reserveColumns(count);
+		itersAlive.reserve(count);
+	}
+
+	// drops every prey at once, keeping the slots for the next world
+	void clear() {
+		clearColumns();
+		itersAlive.clear();
+	}
+
+	void write(std::ostream& out) const {
+		writeColumns(out);
+		writeColumn(out, itersAlive);
+	}
+
+	bool read(std::istream& in) {
+		size_t count = 0;
+		return readColumns(in, count) && readColumn(in, itersAlive, count);
+	}
+};
+
+// A handle on one agent in the store of its species. Every call resolves at
+// compile time; there are no virtual functions and no type tests. Handles are
+// cheap to make and only stay valid until the store is compacted, so they are
+// created on the fly rather than kept.
+template <typename Store>
+class Animal {
+	public:
+	static constexpr Species SPECIES = Store::SPECIES;
+
+	Animal(Store& agentStore, size_t agentIndex) : store(&agentStore), index(agentIndex) {}
+	
+	void reproduced() {store->itersSinceRepro[index] = 0;}
+	olc::Pixel getColor() {return store->color[index];}
+	int getX() { return store->pos[index].x;}
+	int getY() { return store->pos[index].y;}
+	int getPrevX() { return store->prevPos[index].x;}
+	int getPrevY() { return store->prevPos[index].y;}
+	olc::vi2d getPos() {return store->pos[index];}
+	olc::vi2d getPrevPos() {return store->prevPos[index];}
+	void move(int xpos, int ypos) {move(olc::vi2d(xpos, ypos));}
+	void move(olc::vi2d newPos) {store->prevPos[index] = store->pos[index]; store->pos[index] = newPos;}
+	void die() {store->alive[index] = 0;}
+	bool isAlive() {return store->alive[index] != 0;}
+	size_t getIndex() {return index;}
+	uint64_t getId() {return store->id[index];}
+
+	protected:
+	Store* store;
+	size_t index;
+
+};
+
+class Predator : public Animal<PredatorStore> {
+	public:
+	static constexpr int RADIUS = 5;
+
+	Predator(PredatorStore& predators, size_t agentIndex) : Animal(predators, agentIndex) {}
+
+	void eat() {
+		store->itersSinceFood[index] = 0;
+	}
+
+	bool canReproduce() {
+		return store->itersSinceRepro[index] > 35;
+	}
+};
+
+class Prey : public Animal<PreyStore> {
+	public:
+	Prey(PreyStore& preys, size_t agentIndex) : Animal(preys, agentIndex) {}
+
+	bool canReproduce() {
+		return store->itersSinceRepro[index] >= 25;
+	}
+};
+
+constexpr auto PREDATOR_SIGHT = makeSightDisk<Predator::RADIUS>();
+
+// The 8 neighbours of a cell, row by row. Bit k of a neighbour mask stands for NEIGHBOURS[k].
+constexpr SightOffset NEIGHBOURS[8] = {{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+// The cells an agent could step to, at most its neighbours and its own cell,
+// held on the stack.
+struct MoveCandidates {
+	olc::vi2d cells[9];
+	int count = 0;
+
+	// the cells of mask around center in row order, with center itself in its
+	// place among them when withCenter is set
+	MoveCandidates(olc::vi2d center, uint8_t mask, bool withCenter) {
+		for(int k = 0; k < 8; k++) {
+			// the centre sits between the left and right neighbours
+			if(k == 4 && withCenter) cells[count++] = center;
+			if(mask & (1 << k)) cells[count++] = olc::vi2d(center.x + NEIGHBOURS[k].dx, center.y + NEIGHBOURS[k].dy);
+		}
+	}
+
+	bool empty() const { return count == 0; }
+
+	int size() const { return count; }
+
+	olc::vi2d operator[](int i) const { return cells[i]; }
+
+	void erase(int i) {
+		for(int j = i + 1; j < count; j++) cells[j - 1] = cells[j];
+		count--;
+	}
+};
+
+// one 64-bit key per cell: x in the low half, y in the high half
+uint64_t packCell(olc::vi2d v) {
+	return (static_cast<uint64_t>(static_cast<uint32_t>(v.y)) << 32) | static_cast<uint32_t>(v.x);
+}
+
+olc::vi2d unpackCell(uint64_t key) {
+	return olc::vi2d(static_cast<int32_t>(static_cast<uint32_t>(key)), static_cast<int32_t>(static_cast<uint32_t>(key >> 32)));
+}
+
+// packs the cell and mixes it, so neighbouring cells land far apart in a table
+struct HASH_OLC_VI2D
+{
+	std::size_t operator()(const olc::vi2d &v) const
+	{
+		return static_cast<std::size_t>(mix64(packCell(v)));
+	}
+};
+
+// how far lookups in a FlatCellMap have to walk
+struct ProbeStats {
+	size_t entries = 0;
+	size_t capacity = 0;
+	// slots looked at by a successful lookup
+	double meanProbe = 0.0;
+	size_t maxProbe = 0;
+};
+
+// Open-addressing map from cells to values, for worlds too sparse for a dense grid.
+// Keys are packed cells, slots are probed linearly from the hashed home slot and a
+// removal shifts the rest of its run back, so there are no tombstones. The table
+// doubles before it gets more than half full.
+template <typename V, typename Hash = HASH_OLC_VI2D>
+class FlatCellMap {
+public:
+	size_t size() const { return count; }
+	size_t capacity() const { return used.size(); }
+	bool empty() const { return count == 0; }
+
+	void reserve(size_t entries) {
+		size_t needed = MIN_CAPACITY;
+		while(needed < entries * 2) needed *= 2;
+		if(needed > used.size()) rehash(needed);
+	}
+
+	// keeps the capacity
+	void clear() {
+		std::fill(used.begin(), used.end(), 0);
+		std::fill(values.begin(), values.end(), V());
+		count = 0;
+	}
+
+	V* find(olc::vi2d cell) {
+		if(count == 0) return nullptr;
+		uint64_t key = packCell(cell);
+		for(size_t slot = home(cell); used[slot]; slot = (slot + 1) & mask) {
+			if(keys[slot] == key) return &values[slot];
+		}
+		return nullptr;
+	}
+
+	const V* find(olc::vi2d cell) const { return const_cast<FlatCellMap*>(this)->find(cell); }
+
+	bool contains(olc::vi2d cell) const { return find(cell) != nullptr; }
+
+	// the value at cell, value-initialised if the cell wasn't in the map yet
+	V& operator[](olc::vi2d cell) {
+		if((count + 1) * 2 > used.size()) rehash(std::max(MIN_CAPACITY, used.size() * 2));
+		uint64_t key = packCell(cell);
+		size_t slot = home(cell);
+		for(; used[slot]; slot = (slot + 1) & mask) {
+			if(keys[slot] == key) return values[slot];
+		}
+		used[slot] = 1;
+		keys[slot] = key;
+		count++;
+		return values[slot];
+	}
+
+	bool erase(olc::vi2d cell) {
+		if(count == 0) return false;
+		uint64_t key = packCell(cell);
+		size_t hole = home(cell);
+		while(used[hole] && keys[hole] != key) hole = (hole + 1) & mask;
+		if(!used[hole]) return false;
+
+		// pull back every later entry of the run that may sit in the hole,
+		// i.e. whose home slot isn't between the hole and where it is now
+		for(size_t next = (hole + 1) & mask; used[next]; next = (next + 1) & mask) {
+			size_t wanted = home(unpackCell(keys[next]));
+			if(((next - wanted) & mask) >= ((next - hole) & mask)) {
+				keys[hole] = keys[next];
+				values[hole] = std::move(values[next]);
+				hole = next;
+			}
+		}
+		used[hole] = 0;
+		values[hole] = V();
+		count--;
+		return true;
+	}
+
+	template <typename Fn>
+	void forEach(Fn fn) {
+		for(size_t slot = 0; slot < used.size(); slot++) {
+			if(used[slot]) fn(unpackCell(keys[slot]), values[slot]);
+		}
+	}
+
+	ProbeStats probeStats() const {
+		ProbeStats stats;
+		stats.entries = count;
+		stats.capacity = used.size();
+		size_t total = 0;
+		for(size_t slot = 0; slot < used.size(); slot++) {
+			if(!used[slot]) continue;
+			size_t probe = ((slot - home(unpackCell(keys[slot]))) & mask) + 1;
+			total += probe;
+			stats.maxProbe = std::max(stats.maxProbe, probe);
+		}
+		stats.meanProbe = count ? static_cast<double>(total) / count : 0.0;
+		return stats;
+	}
+
+private:
+	static constexpr size_t MIN_CAPACITY = 16;
+
+	std::vector<uint64_t> keys;
+	std::vector<V> values;
+	std::vector<uint8_t> used;
+	size_t mask = 0;
+	size_t count = 0;
+
+	size_t home(olc::vi2d cell) const { return Hash()(cell) & mask; }
+
+	void rehash(size_t newCapacity) {
+		std::vector<uint64_t> oldKeys = std::move(keys);
+		std::vector<V> oldValues = std::move(values);
+		std::vector<uint8_t> oldUsed = std::move(used);
+		keys.assign(newCapacity, 0);
+		values.assign(newCapacity, V());
+		used.assign(newCapacity, 0);
+		mask = newCapacity - 1;
+		for(size_t i = 0; i < oldUsed.size(); i++) {
+			if(!oldUsed[i]) continue;
+			size_t slot = home(unpackCell(oldKeys[i]));
+			while(used[slot]) slot = (slot + 1) & mask;
+			used[slot] = 1;
+			keys[slot] = oldKeys[i];
+			values[slot] = std::move(oldValues[i]);
+		}
+	}
+};
+
+int distSquared(olc::vi2d from, olc::vi2d to) {
+	int dx = from.x - to.x;
+	int dy = from.y - to.y;
+	return dx * dx + dy * dy;
+}
+
+// Dense occupancy for the bounded world, one entry per cell stored row by row.
+// An entry is 0 for an empty cell, otherwise the agent's index in its store + 1
+// with the top bit set when the agent is a predator.
+class OccupancyGrid {
+public:
+	static constexpr uint32_t EMPTY = 0;
+	static constexpr uint32_t PREDATOR_BIT = 0x80000000u;
+
+	static uint32_t encode(size_t index, Species species) { return static_cast<uint32_t>(index + 1) | (species == Species::PREDATOR ? PREDATOR_BIT : 0); }
+	static bool isPredator(uint32_t entry) { return (entry & PREDATOR_BIT) != 0; }
+	static size_t indexOf(uint32_t entry) { return (entry & ~PREDATOR_BIT) - 1; }
+
+	void reset(int newWidth, int newHeight) {
+		width = newWidth;
+		height = newHeight;
+		cells.assign(static_cast<size_t>(width) * height, EMPTY);
+	}
+
+	void clear() { std::fill(cells.begin(), cells.end(), EMPTY); }
+
+	bool inBounds(olc::vi2d cell) const { return cell.x >= 0 && cell.x < width && cell.y >= 0 && cell.y < height; }
+
+	// cells outside the world read as empty
+	uint32_t get(olc::vi2d cell) const { return inBounds(cell) ? cells[index(cell)] : EMPTY; }
+
+	void set(olc::vi2d cell, uint32_t entry) { cells[index(cell)] = entry; }
+
+	// only clears the cell if it still holds this entry, so an agent that was
+	// overwritten (e.g. a prey that got eaten) can't evict whoever replaced it
+	void release(olc::vi2d cell, uint32_t entry) {
+		if(inBounds(cell) && cells[index(cell)] == entry) {
+			cells[index(cell)] = EMPTY;
+		}
+	}
+
+private:
+	size_t index(olc::vi2d cell) const { return static_cast<size_t>(cell.y) * width + cell.x; }
+
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> cells;
+};
+
+// A fixed set of worker threads that split an index range between them.
+// The calling thread works on the first chunk, so a pool of one runs everything inline.
+class WorkerPool {
+public:
+	explicit WorkerPool(int threadCount) : threadCount(std::max(threadCount, 1)) {
+		for(int worker = 1; worker < this->threadCount; worker++) {
+			threads.emplace_back([this, worker]() { workerLoop(worker); });
+		}
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(auto& thread: threads) {
+			thread.join();
+		}
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	int size() const { return threadCount; }
+
+	// calls task(begin, end, worker) on contiguous, equally sized chunks of
+	// [0, count) and returns once every chunk is done; chunk k always goes to worker k
+	void parallelFor(size_t count, const std::function<void(size_t, size_t, int)>& task) {
+		if(threadCount == 1 || count < static_cast<size_t>(threadCount)) {
+			task(0, count, 0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			currentTask = &task;
+			currentCount = count;
+			pending = threadCount - 1;
+			generation++;
+		}
+		wake.notify_all();
+		runChunk(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return pending == 0; });
+		currentTask = nullptr;
+	}
+
+private:
+	void runChunk(int worker) {
+		size_t chunk = (currentCount + threadCount - 1) / threadCount;
+		size_t begin = std::min(currentCount, chunk * worker);
+		size_t end = std::min(currentCount, begin + chunk);
+		if(begin < end) {
+			(*currentTask)(begin, end, worker);
+		}
+	}
+
+	void workerLoop(int worker) {
+		unsigned long long seen = 0;
+		while(true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+				if(stopping) return;
+				seen = generation;
+			}
+			runChunk(worker);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending--;
+			}
+			done.notify_one();
+		}
+	}
+
+	int threadCount;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t, size_t, int)>* currentTask = nullptr;
+	size_t currentCount = 0;
+	int pending = 0;
+	unsigned long long generation = 0;
+	bool stopping = false;
+};
+
+// Bridson's Poisson-disk sampling for several classes of points in one pass, e.g.
+// predators and preys that keep one distance among themselves and another from
+// each other. Samples live in a dense background grid with cells small enough to
+// hold at most one sample, so a candidate only checks a fixed set of nearby cells.
+// Candidates come from a table of annulus offsets drawn once, instead of a cos and
+// a sin per try. Classes are filled in the order given: a point of a later class is
+// only expanded once every earlier class has run out of active points.
+class PoissonDiskSampler {
+public:
+	struct PointClass {
+		// candidates are drawn between spawnRadius and twice that from an active point
+		float spawnRadius;
+		// candidates drawn around an active point before it's retired
+		int tries;
+		// random points each class starts from, per tile when sampling in tiles
+		int startPoints;
+	};
+
+	// minDistance[a][b] is how close a point of class a may be to one of class b
+	PoissonDiskSampler(int gridWidth, int gridHeight, std::vector<PointClass> pointClasses, std::vector<std::vector<float>> minDistance) :
+		width(gridWidth), height(gridHeight), classes(std::move(pointClasses)), distance2(classes.size(), std::vector<int>(classes.size())) {
+		float smallest = std::numeric_limits<float>::max();
+		for(size_t a = 0; a < classes.size(); a++) {
+			for(size_t b = 0; b < classes.size(); b++) {
+				smallest = std::min(smallest, minDistance[a][b]);
+				// points sit on whole cells, so closer than r means a squared distance below ceil(r^2)
+				distance2[a][b] = static_cast<int>(std::ceil(minDistance[a][b] * minDistance[a][b]));
+			}
+		}
+		cellSize = std::max(1.0f, smallest / std::sqrt(2.0f));
+		gridColumns = static_cast<int>(std::ceil(width / cellSize));
+		gridRows = static_cast<int>(std::ceil(height / cellSize));
+		cellPos.assign(static_cast<size_t>(gridColumns) * gridRows, olc::vi2d(0, 0));
+		cellClass.assign(static_cast<size_t>(gridColumns) * gridRows, NONE);
+
+		// the grid cells that can hold a point too close to one in the middle cell
+		int widestSpan = 1;
+		for(size_t a = 0; a < classes.size(); a++) {
+			float reach = *std::max_element(minDistance[a].begin(), minDistance[a].end());
+			int span = static_cast<int>(std::ceil(reach / cellSize));
+			widestSpan = std::max(widestSpan, span);
+			std::vector<SightOffset> offsets;
+			for(int dy = -span; dy <= span; dy++) {
+				for(int dx = -span; dx <= span; dx++) {
+					float gapX = std::max(std::abs(dx) - 1, 0) * cellSize;
+					float gapY = std::max(std::abs(dy) - 1, 0) * cellSize;
+					if(gapX * gapX + gapY * gapY < reach * reach) offsets.push_back(SightOffset{dx, dy});
+				}
+			}
+			neighbourCells.push_back(offsets);
+		}
+		// a tile only reads the cells within reach of it, so tiles at least that wide
+		// never look past their neighbours
+		tileCells = std::max(widestSpan, MIN_TILE_CELLS);
+		tileColumns = (gridColumns + tileCells - 1) / tileCells;
+		tileRows = (gridRows + tileCells - 1) / tileCells;
+	}
+
+	// Fills the grid and returns the points of every class. walkable(cell) says
+	// whether a point may go on a cell at all, spacing aside.
+	template <typename Walkable>
+	std::vector<std::vector<olc::vi2d>> sample(std::mt19937& generator, Walkable walkable) {
+		std::vector<std::vector<olc::vi2d>> annuli = makeAnnuli(generator);
+		std::vector<std::vector<olc::vi2d>> points(classes.size());
+		std::uniform_int_distribution<> startX(0, width - 1);
+		std::uniform_int_distribution<> startY(0, height - 1);
+		std::vector<std::vector<olc::vi2d>> active(classes.size());
+		for(size_t c = 0; c < classes.size(); c++) {
+			for(int i = 0; i < classes[c].startPoints; i++) {
+				// give up on a start point rather than spin forever on a world with no room
+				for(int attempt = 0; attempt < MAX_START_ATTEMPTS; attempt++) {
+					olc::vi2d start(startX(generator), startY(generator));
+					if(walkable(start) && farEnough(start, c)) {
+						add(start, c, points[c], active[c]);
+						break;
+					}
+				}
+			}
+		}
+		for(size_t c = 0; c < classes.size(); c++) {
+			expand(c, active[c], points[c], annuli[c], generator, walkable, 0, 0, gridColumns, gridRows);
+		}
+		return points;
+	}
 
-class Animal {
-	public:
-	Animal(int xpos, int ypos, olc::Pixel newColor) : pos(olc::vi2d(xpos, ypos)), prevPos(olc::vi2d(xpos, ypos)), itersSinceRepro(0), color(newColor), isDead(false) {}
-	Animal(olc::vi2d newPos, olc::Pixel newColor) : pos(newPos), prevPos(newPos), itersSinceRepro(0), color(newColor), isDead(false) {}
-	virtual ~Animal() = default;
-	
-	virtual void update() = 0;
-	virtual std::string getType() = 0;
-	virtual bool canReproduce() = 0;
-	void reproduced() {itersSinceRepro = 0;}
-	olc::Pixel getColor() {return color;}
-	int getX() { return pos.x;}
-	int getY() { return pos.y;}
-	int getPrevX() { return prevPos.x;}
-	int getPrevY() { return prevPos.y;}
-	olc::vi2d getPos() {return pos;}
-	olc::vi2d getPrevPos() {return prevPos;}
-	void move(int xpos, int ypos) {prevPos = pos; pos = olc::vi2d(xpos, ypos);}
-	void move(olc::vi2d newPos) {prevPos = pos; pos = newPos;}
-	void die() {isDead = true;}
-	bool isAlive() {return !isDead;}
+	// Same as sample(), but the grid is cut into square tiles that are filled on the
+	// workers, colour by colour in a 2x2 pattern: tiles of one colour are a whole tile
+	// apart, which is further than any point can see, so they never touch the same
+	// cells. Every tile seeds its own points and draws from its own generator, so the
+	// result depends on the seed but not on the number of workers. Each class is
+	// still finished before the next one starts.
+	template <typename Walkable>
+	std::vector<std::vector<olc::vi2d>> sampleTiled(uint64_t seed, WorkerPool& workers, Walkable walkable) {
+		std::seed_seq annulusSeed{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+		std::mt19937 annulusGenerator(annulusSeed);
+		std::vector<std::vector<olc::vi2d>> annuli = makeAnnuli(annulusGenerator);
+
+		size_t tileCount = static_cast<size_t>(tileColumns) * tileRows;
+		std::vector<std::vector<olc::vi2d>> points(classes.size());
+		for(size_t c = 0; c < classes.size(); c++) {
+			std::vector<std::vector<olc::vi2d>> tilePoints(tileCount);
+			for(int colour = 0; colour < 4; colour++) {
+				int firstColumn = colour % 2;
+				int firstRow = colour / 2;
+				int columns = (tileColumns - firstColumn + 1) / 2;
+				int rows = (tileRows - firstRow + 1) / 2;
+				workers.parallelFor(static_cast<size_t>(columns) * rows, [&](size_t begin, size_t end, int) {
+					for(size_t i = begin; i < end; i++) {
+						int tileX = firstColumn + 2 * static_cast<int>(i % columns);
+						int tileY = firstRow + 2 * static_cast<int>(i / columns);
+						size_t tile = static_cast<size_t>(tileY) * tileColumns + tileX;
+						fillTile(c, tileX, tileY, seed, tile, annuli[c], walkable, tilePoints[tile]);
+					}
+				});
+			}
+			for(const std::vector<olc::vi2d>& tile: tilePoints) {
+				points[c].insert(points[c].end(), tile.begin(), tile.end());
+			}
+		}
+		return points;
+	}
 
-	protected:
-	olc::vi2d pos;
-	olc::vi2d prevPos;
-	int itersSinceRepro;
-	bool isDead;
-	olc::Pixel color;
+private:
+	static constexpr uint8_t NONE = 0xff;
+	static constexpr int ANNULUS_SIZE = 1024;
+	static constexpr int MAX_START_ATTEMPTS = 10000;
+	static constexpr int MIN_TILE_CELLS = 16;
+
+	// offsets between radius and twice that, radius and angle both uniform
+	std::vector<std::vector<olc::vi2d>> makeAnnuli(std::mt19937& generator) {
+		std::vector<std::vector<olc::vi2d>> annuli;
+		for(const PointClass& pointClass: classes) {
+			std::uniform_real_distribution<float> randRadius(pointClass.spawnRadius, 2 * pointClass.spawnRadius);
+			std::uniform_real_distribution<float> randAngle(0, 2 * 3.1415926f);
+			std::vector<olc::vi2d> annulus(ANNULUS_SIZE);
+			for(olc::vi2d& offset: annulus) {
+				float r = randRadius(generator);
+				float a = randAngle(generator);
+				offset = olc::vi2d(static_cast<int>(std::round(r * std::cos(a))), static_cast<int>(std::round(r * std::sin(a))));
+			}
+			annuli.push_back(annulus);
+		}
+		return annuli;
+	}
 
-};
+	template <typename Walkable>
+	void fillTile(size_t pointClass, int tileX, int tileY, uint64_t seed, size_t tile, const std::vector<olc::vi2d>& annulus, Walkable& walkable, std::vector<olc::vi2d>& points) {
+		std::seed_seq tileSeed{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), static_cast<uint32_t>(tile), static_cast<uint32_t>(pointClass)};
+		std::mt19937 generator(tileSeed);
+		int minColumn = tileX * tileCells;
+		int minRow = tileY * tileCells;
+		int maxColumn = std::min(minColumn + tileCells, gridColumns);
+		int maxRow = std::min(minRow + tileCells, gridRows);
+		int minX = static_cast<int>(std::ceil(minColumn * cellSize));
+		int minY = static_cast<int>(std::ceil(minRow * cellSize));
+		int maxX = std::min(width, static_cast<int>(std::ceil(maxColumn * cellSize))) - 1;
+		int maxY = std::min(height, static_cast<int>(std::ceil(maxRow * cellSize))) - 1;
+		if(minX > maxX || minY > maxY) return;
+
+		std::uniform_int_distribution<> startX(minX, maxX);
+		std::uniform_int_distribution<> startY(minY, maxY);
+		std::vector<olc::vi2d> active;
+		for(int i = 0; i < classes[pointClass].startPoints; i++) {
+			// a few darts are enough, a tile of ocean or one already full just stays empty
+			for(int attempt = 0; attempt < classes[pointClass].tries; attempt++) {
+				olc::vi2d start(startX(generator), startY(generator));
+				if(walkable(start) && farEnough(start, pointClass)) {
+					add(start, pointClass, points, active);
+					break;
+				}
+			}
+		}
+		expand(pointClass, active, points, annulus, generator, walkable, minColumn, minRow, maxColumn, maxRow);
+	}
 
-class Predator : public Animal {
-	public:
-	int const RADIUS = 5;
+	// Bridson's loop, keeping new points to the grid columns and rows given
+	template <typename Walkable>
+	void expand(size_t pointClass, std::vector<olc::vi2d>& active, std::vector<olc::vi2d>& points, const std::vector<olc::vi2d>& annulus,
+		std::mt19937& generator, Walkable& walkable, int minColumn, int minRow, int maxColumn, int maxRow) {
+		std::uniform_int_distribution<> randOffset(0, ANNULUS_SIZE - 1);
+		while(!active.empty()) {
+			std::uniform_int_distribution<> randIndex(0, active.size() - 1);
+			int index = randIndex(generator);
+			olc::vi2d basePt = active[index];
+			bool valid = false;
 
-	Predator(int xpos, int ypos, olc::Pixel newColor) : Animal(xpos, ypos, newColor), itersSinceFood(0) {}
-	Predator(olc::vi2d newPos, olc::Pixel newColor) : Animal(newPos, newColor), itersSinceFood(0) {}
-	
-	void update() override {
-		itersSinceFood++;
-		itersSinceRepro++;
-		isDead = itersSinceFood > 35;
+			for(int i = 0; i < classes[pointClass].tries; i++) {
+				olc::vi2d candidate = basePt + annulus[randOffset(generator)];
+				if(candidate.x < 0 || candidate.y < 0 || candidate.x >= width || candidate.y >= height) continue;
+				int column = static_cast<int>(candidate.x / cellSize);
+				int row = static_cast<int>(candidate.y / cellSize);
+				if(column < minColumn || row < minRow || column >= maxColumn || row >= maxRow) continue;
+				if(!walkable(candidate) || !farEnough(candidate, pointClass)) continue;
+
+				add(candidate, pointClass, points, active);
+				valid = true;
+				break;
+			}
+
+			if(!valid) {
+				active[index] = active.back();
+				active.pop_back();
+			}
+		}
 	}
 
-	void eat() {
-		itersSinceFood = 0;
+	size_t cellOf(olc::vi2d pos) const {
+		return static_cast<size_t>(pos.y / cellSize) * gridColumns + static_cast<size_t>(pos.x / cellSize);
 	}
 
-	std::string getType() {
-		return "Predator";
+	bool farEnough(olc::vi2d pos, size_t pointClass) const {
+		int gridX = static_cast<int>(pos.x / cellSize);
+		int gridY = static_cast<int>(pos.y / cellSize);
+		for(const SightOffset& offset: neighbourCells[pointClass]) {
+			int x = gridX + offset.dx;
+			int y = gridY + offset.dy;
+			if(x < 0 || y < 0 || x >= gridColumns || y >= gridRows) continue;
+			size_t cell = static_cast<size_t>(y) * gridColumns + x;
+			if(cellClass[cell] == NONE) continue;
+			if(distSquared(cellPos[cell], pos) < distance2[pointClass][cellClass[cell]]) {
+				return false;
+			}
+		}
+		return true;
 	}
 
-	bool canReproduce() {
-		return itersSinceRepro > 35;
+	void add(olc::vi2d pos, size_t pointClass, std::vector<olc::vi2d>& points, std::vector<olc::vi2d>& active) {
+		size_t cell = cellOf(pos);
+		cellPos[cell] = pos;
+		cellClass[cell] = static_cast<uint8_t>(pointClass);
+		points.push_back(pos);
+		active.push_back(pos);
 	}
-	
-	private:
-	int itersSinceFood;
+
+	int width;
+	int height;
+	std::vector<PointClass> classes;
+	std::vector<std::vector<int>> distance2;
+	std::vector<std::vector<SightOffset>> neighbourCells;
+	float cellSize = 1.0f;
+	int gridColumns = 0;
+	int gridRows = 0;
+	// the sample in each background cell and its class, row by row
+	std::vector<olc::vi2d> cellPos;
+	std::vector<uint8_t> cellClass;
+	// side of a tile in grid cells, and the number of tiles across and down
+	int tileCells = 1;
+	int tileColumns = 0;
+	int tileRows = 0;
 };
 
-class Prey : public Animal {
-	public:
-	Prey(int xpos, int ypos, olc::Pixel newColor) : Animal(xpos, ypos, newColor), itersAlive(0) {}
-	Prey(olc::vi2d newPos, olc::Pixel newColor) : Animal(newPos, newColor), itersAlive(0) {}
+// Phase timings for finding out where a tick goes. Every thread records into its
+// own ring of events, written only by that thread and published with one atomic
+// store, so recording takes no lock. Once a ring is full the oldest events are
+// overwritten. The rings are read when the run ends, to write a Chrome trace
+// (chrome://tracing or ui.perfetto.dev) and to print per-phase percentiles.
+class Profiler {
+public:
+	struct Event {
+		const char* name;
+		uint64_t startNs;
+		uint64_t durationNs;
+	};
+
+	static Profiler& instance() {
+		static Profiler profiler;
+		return profiler;
+	}
 
-	void update() {
-		itersSinceRepro++;
-		itersAlive++;
-		isDead = itersAlive > 26;
+	void enable() { enabled.store(true, std::memory_order_relaxed); }
+
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	uint64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
 	}
 
-	std::string getType() {
-		return "Prey";
+	// name must outlive the profiler, in practice a string literal
+	void record(const char* name, uint64_t startNs, uint64_t durationNs) {
+		thread_local ThreadRing* ring = nullptr;
+		if(!ring) {
+			ring = registerThread();
+		}
+		uint64_t written = ring->written.load(std::memory_order_relaxed);
+		ring->events[written & (RING_CAPACITY - 1)] = Event{name, startNs, durationNs};
+		ring->written.store(written + 1, std::memory_order_release);
 	}
 
-	bool canReproduce() {
-		return itersSinceRepro >= 25;
+	bool writeChromeTrace(const std::string& path) {
+		std::ofstream out(path);
+		if(!out) return false;
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		forEachEvent([&](int thread, const Event& event) {
+			out << (first ? "\n" : ",\n");
+			out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+				<< ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+			first = false;
+		});
+		out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return true;
 	}
 
-	private:
-	int itersAlive;
+	void printSummary(FILE* out) {
+		std::map<std::string, std::vector<uint64_t>> durations;
+		forEachEvent([&](int, const Event& event) {
+			durations[event.name].push_back(event.durationNs);
+		});
+		fprintf(out, "%-24s %10s %10s %10s %10s %12s\n", "phase", "count", "p50 ms", "p95 ms", "p99 ms", "total ms");
+		for(auto& [name, samples]: durations) {
+			std::sort(samples.begin(), samples.end());
+			uint64_t total = 0;
+			for(uint64_t sample: samples) total += sample;
+			fprintf(out, "%-24s %10zu %10.3f %10.3f %10.3f %12.1f\n", name.c_str(), samples.size(),
+				percentile(samples, 0.50) / 1e6, percentile(samples, 0.95) / 1e6, percentile(samples, 0.99) / 1e6, total / 1e6);
+		}
+	}
 
-};
+private:
+	static constexpr size_t RING_CAPACITY = 1 << 16;
 
-struct HASH_OLC_VI2D
-{
-	std::size_t operator()(const olc::vi2d &v) const
-	{
-		return int64_t(v.y << sizeof(int32_t) | v.x);
+	struct ThreadRing {
+		int thread;
+		std::vector<Event> events;
+		std::atomic<uint64_t> written{0};
+
+		explicit ThreadRing(int threadNumber) : thread(threadNumber), events(RING_CAPACITY) {}
+	};
+
+	Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+	ThreadRing* registerThread() {
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		rings.push_back(std::make_unique<ThreadRing>(static_cast<int>(rings.size())));
+		return rings.back().get();
 	}
-};
 
-int distSquared(olc::vi2d from, olc::vi2d to) {
-	int dx = from.x - to.x;
-	int dy = from.y - to.y;
-	return dx * dx + dy * dy;
-}
+	// the events still held by every ring, oldest first per thread
+	template <typename Visit>
+	void forEachEvent(Visit visit) {
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for(const auto& ring: rings) {
+			uint64_t written = ring->written.load(std::memory_order_acquire);
+			uint64_t first = written > RING_CAPACITY ? written - RING_CAPACITY : 0;
+			for(uint64_t i = first; i < written; i++) {
+				visit(ring->thread, ring->events[i & (RING_CAPACITY - 1)]);
+			}
+		}
+	}
 
-struct SpacialHash {
-	float cellSize;
-	std::unordered_map<long long, int> cells;
+	// nearest rank on sorted samples
+	static double percentile(const std::vector<uint64_t>& sorted, double p) {
+		if(sorted.empty()) return 0.0;
+		size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+		return static_cast<double>(sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1]);
+	}
 
-	SpacialHash(float radius) : cellSize(radius/std::sqrt(2.0)) {}
+	std::chrono::steady_clock::time_point epoch;
+	std::atomic<bool> enabled{false};
+	std::mutex ringsMutex;
+	std::vector<std::unique_ptr<ThreadRing>> rings;
+};
 
-	long long hash(int x, int y) const {
-        return (static_cast<long long>(x) << 32) ^ (y & 0xffffffff);
-    }
+// Times the enclosing scope under a phase name while the profiler is on.
+class ScopedTimer {
+public:
+	explicit ScopedTimer(const char* phaseName) : name(phaseName), active(Profiler::instance().isEnabled()) {
+		if(active) start = Profiler::instance().now();
+	}
 
-	void insert(olc::vi2d pos, int index) {
-		int gridX = (int)std::floor(static_cast<float>(pos.x) / cellSize);
-		int gridY = (int)std::floor(static_cast<float>(pos.y) / cellSize);
-		cells[hash(gridX, gridY)] = index;
+	~ScopedTimer() {
+		if(active) {
+			Profiler& profiler = Profiler::instance();
+			profiler.record(name, start, profiler.now() - start);
+		}
 	}
 
-	bool farEnough(olc::vi2d pos, std::vector<olc::vi2d> points, float radius) {
-		int gridX = (int)std::floor(static_cast<float>(pos.x) / cellSize);
-		int gridY = (int)std::floor(static_cast<float>(pos.y) / cellSize);
-		float radius2 = radius * radius;
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
 
-		for(int i=-2; i<=2; i++) {
-			for(int j=-2; j<=2; j++) {
-				//if(i == 0 && j == 0) continue;
-				auto it = cells.find(hash(gridX + j, gridY + i));
-				if(it == cells.end()) continue;
-				if(distSquared(points[it->second], pos) < radius2) {
-					return false;
+private:
+	const char* name;
+	bool active;
+	uint64_t start = 0;
+};
+
+enum class landType : uint8_t {
+	NONE,
+	OCEAN,
+	BEACH,
+	FOREST,
+	MOUNTAIN,
+	SNOW
+};
+
+// How close the nearest predator is to each cell, rebuilt once per tick before
+// the preys move. A breadth-first search over land starts from every predator at
+// once and stops after a few steps; every cell it reaches records its step count
+// and its squared distance to the predator it was reached from. Cells it doesn't
+// reach read as FAR. Only the cells touched last time are reset.
+class PredatorField {
+public:
+	static constexpr uint8_t FAR = 255;
+	static constexpr uint16_t FAR_DIST = 65535;
+	// enough for the squared distances the search can reach
+	static constexpr int MAX_RANGE = 100;
+
+	// land needs an ocean border at least one cell wide, which keeps the search inside the world
+	void build(const PredatorStore& predators, const Grid2D<landType>& land, int range) {
+		int newWidth = land.getWidth();
+		int newHeight = land.getHeight();
+		if(newWidth != width || newHeight != height) {
+			width = newWidth;
+			height = newHeight;
+			steps.assign(static_cast<size_t>(width) * height, FAR);
+			dist2.assign(static_cast<size_t>(width) * height, FAR_DIST);
+			touched.clear();
+		}
+		for(uint32_t cell: touched) {
+			steps[cell] = FAR;
+			dist2[cell] = FAR_DIST;
+		}
+		touched.clear();
+		frontier.clear();
+		range = std::min(range, MAX_RANGE);
+
+		// room for every predator's whole reach, so the lists only grow along with the predators
+		size_t cells = static_cast<size_t>(width) * height;
+		size_t reach = static_cast<size_t>(2 * range + 1) * (2 * range + 1);
+		touched.reserve(std::min(cells, predators.size() * reach));
+		frontier.reserve(std::min(cells, predators.size() * 8 * range));
+		nextFrontier.reserve(std::min(cells, predators.size() * 8 * range));
+
+		for(size_t i = 0; i < predators.size(); i++) {
+			if(!predators.alive[i]) continue;
+			uint32_t cell = indexOf(predators.pos[i]);
+			if(steps[cell] == 0) continue;
+			steps[cell] = 0;
+			dist2[cell] = 0;
+			touched.push_back(cell);
+			frontier.push_back({cell, cell});
+		}
+
+		for(int level = 1; level <= range && !frontier.empty(); level++) {
+			nextFrontier.clear();
+			for(const auto& [cell, source]: frontier) {
+				int x = cell % width;
+				int y = cell / width;
+				int sx = source % width;
+				int sy = source / width;
+				for(int dy=-1; dy<=1; dy++) {
+					for(int dx=-1; dx<=1; dx++) {
+						int nx = x + dx;
+						int ny = y + dy;
+						if(land(nx, ny) == landType::OCEAN) continue;
+						uint32_t next = static_cast<uint32_t>(ny) * width + nx;
+						uint16_t d2 = static_cast<uint16_t>((nx - sx) * (nx - sx) + (ny - sy) * (ny - sy));
+						if(steps[next] == FAR) {
+							steps[next] = level;
+							dist2[next] = d2;
+							touched.push_back(next);
+							nextFrontier.push_back({next, source});
+						} else if(steps[next] == level && d2 < dist2[next]) {
+							// reached again in the same step from a closer predator
+							dist2[next] = d2;
+							nextFrontier.push_back({next, source});
+						}
+					}
 				}
 			}
+			frontier.swap(nextFrontier);
 		}
-		return true;
 	}
+
+	// search steps from the cell to the nearest predator, FAR if out of range
+	uint8_t stepsAt(olc::vi2d cell) const { return inBounds(cell) ? steps[indexOf(cell)] : FAR; }
+
+	// squared distance to the nearest predator, FAR_DIST if out of range
+	uint16_t distanceAt(olc::vi2d cell) const { return inBounds(cell) ? dist2[indexOf(cell)] : FAR_DIST; }
+
+private:
+	bool inBounds(olc::vi2d cell) const { return cell.x >= 0 && cell.x < width && cell.y >= 0 && cell.y < height; }
+
+	uint32_t indexOf(olc::vi2d cell) const { return static_cast<uint32_t>(cell.y) * width + cell.x; }
+
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> steps;
+	std::vector<uint16_t> dist2;
+	std::vector<uint32_t> touched;
+	// (cell, the predator cell it was reached from)
+	std::vector<std::pair<uint32_t, uint32_t>> frontier;
+	std::vector<std::pair<uint32_t, uint32_t>> nextFrontier;
 };
 
-class SparseEncodedLifeSim : public olc::PixelGameEngine
-{
+// PredatorField for a chunked world, which has no bounds to size a grid by: the
+// same search, with the cells it reaches kept in a FlatCellMap.
+class SparsePredatorField {
 public:
-	SparseEncodedLifeSim()
-	{
-		sAppName = "A Mediumly Sized Predator and Prey Simulation";
-		getDesktopResolution();
+	// isLand(cell) says whether the search may step onto a cell
+	template <typename IsLand>
+	void build(const PredatorStore& predators, IsLand isLand, int range) {
+		// Like PredatorField, only the cells the last search reached are reset, so the
+		// cost follows the predators rather than how big the map once grew. Erasing
+		// costs a few probes a cell, so a map that's still mostly in use is cleared
+		// in one sweep instead.
+		if(touched.size() * 8 < reached.capacity()) {
+			for(olc::vi2d cell: touched) reached.erase(cell);
+		} else {
+			reached.clear();
+		}
+		touched.clear();
+		frontier.clear();
+		range = std::min(range, PredatorField::MAX_RANGE);
+		// like PredatorField, room for every predator's whole reach
+		size_t reach = predators.size() * (2 * range + 1) * (2 * range + 1);
+		reached.reserve(reach);
+		touched.reserve(reach);
+		frontier.reserve(predators.size() * 8 * range);
+		nextFrontier.reserve(predators.size() * 8 * range);
+
+		for(size_t i = 0; i < predators.size(); i++) {
+			if(!predators.alive[i]) continue;
+			olc::vi2d cell = predators.pos[i];
+			if(reached.contains(cell)) continue;
+			reached[cell] = pack(0, 0);
+			touched.push_back(cell);
+			frontier.push_back({cell, cell});
+		}
+
+		for(int level = 1; level <= range && !frontier.empty(); level++) {
+			nextFrontier.clear();
+			for(const auto& [cell, source]: frontier) {
+				for(int dy=-1; dy<=1; dy++) {
+					for(int dx=-1; dx<=1; dx++) {
+						olc::vi2d next(cell.x + dx, cell.y + dy);
+						if(!isLand(next)) continue;
+						uint16_t d2 = static_cast<uint16_t>(distSquared(next, source));
+						uint32_t* known = reached.find(next);
+						if(!known) {
+							reached[next] = pack(level, d2);
+							touched.push_back(next);
+							nextFrontier.push_back({next, source});
+						} else if(stepsOf(*known) == level && d2 < distanceOf(*known)) {
+							// reached again in the same step from a closer predator
+							*known = pack(level, d2);
+							nextFrontier.push_back({next, source});
+						}
+					}
+				}
+			}
+			frontier.swap(nextFrontier);
+		}
 	}
 
-	int getScreenWidth() { return screen_width; }
+	uint8_t stepsAt(olc::vi2d cell) const {
+		const uint32_t* known = reached.find(cell);
+		return known ? stepsOf(*known) : PredatorField::FAR;
+	}
 
-	int getScreenHeight() { return screen_height; }
+	uint16_t distanceAt(olc::vi2d cell) const {
+		const uint32_t* known = reached.find(cell);
+		return known ? distanceOf(*known) : PredatorField::FAR_DIST;
+	}
 
-protected:
-	enum class landType {
-		NONE,
-		OCEAN,
-		BEACH,
-		FOREST,
-		MOUNTAIN,
-		SNOW
+private:
+	static uint32_t pack(int steps, uint16_t dist2) { return static_cast<uint32_t>(steps) | static_cast<uint32_t>(dist2) << 8; }
+	static uint8_t stepsOf(uint32_t packed) { return static_cast<uint8_t>(packed); }
+	static uint16_t distanceOf(uint32_t packed) { return static_cast<uint16_t>(packed >> 8); }
+
+	// steps | squared distance << 8 of every cell the search reached
+	FlatCellMap<uint32_t> reached;
+	// the keys of reached
+	std::vector<olc::vi2d> touched;
+	// (cell, the predator cell it was reached from)
+	std::vector<std::pair<olc::vi2d, olc::vi2d>> frontier;
+	std::vector<std::pair<olc::vi2d, olc::vi2d>> nextFrontier;
+};
+
+// An unbounded world, split into CHUNK_SIZE square chunks that are generated the
+// first time an agent steps into them. A chunk keeps the land, walkable neighbours,
+// colour and occupancy of its cells. Once more chunks are loaded than the memory
+// budget allows, the ones without agents are dropped, least recently used first;
+// they're made again from the same noise if an agent comes back.
+//
+// Only occupy() loads chunks. Everything else just reads, so reads are safe from
+// several threads; cells of chunks that aren't loaded read as empty, and their
+// land is left to the owner to work out from the noise.
+class ChunkedWorld {
+public:
+	static constexpr int CHUNK_SHIFT = 8;
+	static constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+
+	struct Chunk {
+		// in chunks, so the first cell is coord * CHUNK_SIZE
+		olc::vi2d coord;
+		// with a one cell border of the neighbouring chunks' land
+		Grid2D<landType> land;
+		Grid2D<uint8_t> landNeighbours;
+		Grid2D<uint32_t> colors;
+		Grid2D<uint32_t> occupancy;
+		// occupied cells; a chunk with any is never dropped
+		uint32_t agents = 0;
+		long long lastUsed = 0;
+
+		size_t sizeBytes() const { return land.sizeBytes() + landNeighbours.sizeBytes() + colors.sizeBytes() + occupancy.sizeBytes(); }
 	};
 
-	std::unordered_set<std::unique_ptr<Predator>> predators;
-	std::unordered_set<std::unique_ptr<Predator>> newPredators;
-	std::unordered_set<std::unique_ptr<Prey>> preys;
-	std::unordered_set<std::unique_ptr<Prey>> newPreys;
-	std::unordered_map<olc::vi2d, Animal*, HASH_OLC_VI2D> occupancy;
+	struct Stats {
+		size_t loaded = 0;
+		size_t bytes = 0;
+		// chunks allocated, loaded or waiting to be reused
+		size_t slots = 0;
+		uint64_t generated = 0;
+		uint64_t evicted = 0;
+	};
 
-	std::vector<std::vector<float>> terrain;
-	std::vector<std::vector<landType>> land;
-	olc::TransformedView tv;
-	olc::UI_CONTAINER myUI;
+	// generate(chunk) fills in a chunk whose coord is set
+	ChunkedWorld(size_t budgetBytes, std::function<void(Chunk&)> generateChunk) : budget(budgetBytes), generate(std::move(generateChunk)) {}
 
-	std::unique_ptr<olc::Sprite> terrainSprite;
-	std::unique_ptr<olc::Decal> terrainDecal;
+	static olc::vi2d chunkOf(olc::vi2d cell) { return olc::vi2d(cell.x >> CHUNK_SHIFT, cell.y >> CHUNK_SHIFT); }
 
-	std::chrono::system_clock::time_point currTime = std::chrono::system_clock::now();
-	std::chrono::system_clock::time_point prevTime = std::chrono::system_clock::now();
+	static olc::vi2d localOf(olc::vi2d cell) { return olc::vi2d(cell.x & (CHUNK_SIZE - 1), cell.y & (CHUNK_SIZE - 1)); }
 
-	int screen_width = 0;
-	int screen_height = 0;
-	int terrainSize;
-	bool terrainDisplayed = false;
-	bool paused = true;
+	// the loaded chunk holding the cell, if there is one
+	const Chunk* find(olc::vi2d cell) const {
+		const uint32_t* slot = index.find(chunkOf(cell));
+		return slot ? chunks[*slot].get() : nullptr;
+	}
 
-	float const OCEAN_LIM = -0.2;
-	float const BEACH_LIM = 0.0;
-	float const MOUNT_LIM = 0.3;
-	float const SNOW_LIM = 0.5;
-	float const INTER_PRED_R = 15.0f;
-	float const INTER_PREY_R = 5.0f;
-	float const PRED_PREY_R = 8.0f;
-	int const NUMBER_START_PTS = 5;
-	int FPS = 3;
-	// this is how many random vectors will be generated and tested for an active point before inactivated
-	const int TEST_POINTS = 10;
+	// the chunk holding the cell, generated first if it isn't loaded
+	Chunk& load(olc::vi2d cell) {
+		olc::vi2d coord = chunkOf(cell);
+		if(const uint32_t* slot = index.find(coord)) return *chunks[*slot];
 
-	// Will be used to obtain a seed for the random number engine
-	// Standard mersenne_twister_engine seeded with rd()
-	std::mt19937 generator{std::random_device{}()};
+		uint32_t slot;
+		if(!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		} else {
+			slot = static_cast<uint32_t>(chunks.size());
+			chunks.push_back(std::make_unique<Chunk>());
+			// so unloading chunks never allocates
+			candidates.reserve(chunks.size());
+			freeSlots.reserve(chunks.size());
+		}
+		Chunk& chunk = *chunks[slot];
+		chunk.coord = coord;
+		chunk.agents = 0;
+		chunk.lastUsed = now;
+		generate(chunk);
+		index[coord] = slot;
+		loaded.push_back(slot);
+		generated++;
+		return chunk;
+	}
 
-protected:
-	bool OnUserCreate() override
-	{
+	uint32_t occupantAt(olc::vi2d cell) const {
+		const Chunk* chunk = find(cell);
+		return chunk ? chunk->occupancy[localOf(cell)] : OccupancyGrid::EMPTY;
+	}
 
-		tv.Initialise(GetScreenSize());
-		// 137 w
-		// 77 h
-		tv.SetWorldScale({10.0f, 10.0f});
-		// myUI.ToggleDEBUGMODE();
+	void occupy(olc::vi2d cell, uint32_t entry) {
+		Chunk& chunk = load(cell);
+		uint32_t& occupant = chunk.occupancy[localOf(cell)];
+		if(occupant == OccupancyGrid::EMPTY) chunk.agents++;
+		occupant = entry;
+	}
 
-		terrainSize = std::pow(2, std::ceil(std::log2(static_cast<float>(std::max(screen_width, screen_height)) / 10))) + 1;
-		float roughnessDelta = 0.6; // from 0 - 1, the smaller the smoother the results
-		makeTerrain(roughnessDelta);
-		cacheTerrain();
-		displayTerrain();
+	// like OccupancyGrid::release, only clears the cell if it still holds this entry
+	void vacate(olc::vi2d cell, uint32_t entry) {
+		const uint32_t* slot = index.find(chunkOf(cell));
+		if(!slot) return;
+		Chunk& chunk = *chunks[*slot];
+		uint32_t& occupant = chunk.occupancy[localOf(cell)];
+		if(occupant == entry) {
+			occupant = OccupancyGrid::EMPTY;
+			chunk.agents--;
+		}
+	}
 
-		// preys.insert(std::make_unique<Prey>(20, 20, olc::Pixel(255, 255, 0)));
-		// preys.insert(std::make_unique<Prey>(10, 5, olc::Pixel(0, 255, 0)));
-		// predators.insert(std::make_unique<Predator>(0, 20, olc::Pixel(255, 0, 0)));
+	void clearOccupancy() {
+		for(uint32_t slot: loaded) {
+			Chunk& chunk = *chunks[slot];
+			for(int y = 0; y < CHUNK_SIZE; y++) std::fill(chunk.occupancy.row(y), chunk.occupancy.row(y) + CHUNK_SIZE, OccupancyGrid::EMPTY);
+			chunk.agents = 0;
+		}
+	}
 
-		poissonDiskSample();
+	// unloads every chunk, keeping the memory for the next world
+	void clear() {
+		for(uint32_t slot: loaded) freeSlots.push_back(slot);
+		loaded.clear();
+		index.clear();
+	}
 
-		myUI.addNewButton(UIStyle::UI_RED, olc::Key::Q, false, "EXIT", screen_width - 40, 0, 40, 20, "EXIT");
-		// myUI.addNewDropDown(UI_BLACK, UI_BLACK, screen_width - 15, 20, 15, "<", "FIRST,SECOND,EXIT", "CMD_1,CMD_2,EXIT");
+	// Stamps the chunks that hold agents as used at tick, then drops the least
+	// recently used empty chunks until the loaded ones fit the budget again.
+	void trim(long long tick) {
+		now = tick;
+		for(uint32_t slot: loaded) {
+			if(chunks[slot]->agents > 0) chunks[slot]->lastUsed = now;
+		}
+		size_t chunkBytes = chunks.empty() ? 0 : chunks[0]->sizeBytes();
+		if(loaded.size() * chunkBytes <= budget) return;
 
-		return true;
+		candidates.clear();
+		for(uint32_t slot: loaded) {
+			if(chunks[slot]->agents == 0) candidates.push_back(slot);
+		}
+		std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return chunks[a]->lastUsed < chunks[b]->lastUsed; });
+		size_t keep = budget / std::max<size_t>(chunkBytes, 1);
+		size_t drop = std::min(candidates.size(), loaded.size() - std::min(loaded.size(), keep));
+		for(size_t i = 0; i < drop; i++) {
+			index.erase(chunks[candidates[i]]->coord);
+			freeSlots.push_back(candidates[i]);
+			evicted++;
+		}
+		loaded.erase(std::remove_if(loaded.begin(), loaded.end(), [this](uint32_t slot) { return !index.contains(chunks[slot]->coord); }), loaded.end());
 	}
 
-	olc::vi2d randVector(olc::vi2d base, float radius) {
-		std::uniform_real_distribution<> randRadius(radius, 2*radius);
-		std::uniform_real_distribution<> randAngle(0, 2*3.1415926);
-
-		float r = randRadius(generator);
-		float a = randAngle(generator);
+	size_t getBudget() const { return budget; }
 
-		return olc::vi2d(static_cast<int>(base.x + r * std::cos(a)), static_cast<int>(base.y + r * std::sin(a)));
+	Stats stats() const {
+		Stats result;
+		result.loaded = loaded.size();
+		result.bytes = loaded.size() * (chunks.empty() ? 0 : chunks[0]->sizeBytes());
+		result.slots = chunks.size();
+		result.generated = generated;
+		result.evicted = evicted;
+		return result;
 	}
 
-	std::pair<std::vector<olc::vi2d>, SpacialHash> generatePredators() {
-		std::vector<olc::vi2d> points;
-		std::vector<olc::vi2d> active;
+private:
+	size_t budget;
+	std::function<void(Chunk&)> generate;
+	// chunk coord -> slot in chunks
+	FlatCellMap<uint32_t> index;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::vector<uint32_t> loaded;
+	std::vector<uint32_t> freeSlots;
+	// reused by trim()
+	std::vector<uint32_t> candidates;
+	long long now = 0;
+	uint64_t generated = 0;
+	uint64_t evicted = 0;
+};
 
-		// the r/sqrt(2) grid for O(N) neighbor checking
-		SpacialHash grid(INTER_PRED_R);
+// The knobs of a world. The defaults are the values the simulation was tuned with;
+// parameter sweeps vary them between runs.
+struct SimParams {
+	float roughnessDelta = 0.6f; // from 0 - 1, the smaller the smoother the results
+	float oceanLim = -0.2f;
+	float beachLim = 0.0f;
+	float mountLim = 0.3f;
+	float snowLim = 0.5f;
+	float interPredR = 15.0f;
+	float interPreyR = 5.0f;
+	float predPreyR = 8.0f;
+	int predatorStarvation = 35;
+	int preyLifespan = 26;
+	// how many steps away a prey notices a predator and starts to flee
+	int preyVision = 1;
+};
 
+// sets a parameter by the name used on the command line, false if there is no such parameter
+bool setParam(SimParams& params, const std::string& name, float value) {
+	if(name == "roughnessDelta") params.roughnessDelta = value;
+	else if(name == "oceanLim") params.oceanLim = value;
+	else if(name == "beachLim") params.beachLim = value;
+	else if(name == "mountLim") params.mountLim = value;
+	else if(name == "snowLim") params.snowLim = value;
+	else if(name == "interPredR") params.interPredR = value;
+	else if(name == "interPreyR") params.interPreyR = value;
+	else if(name == "predPreyR") params.predPreyR = value;
+	else if(name == "predatorStarvation") params.predatorStarvation = static_cast<int>(value);
+	else if(name == "preyLifespan") params.preyLifespan = static_cast<int>(value);
+	else if(name == "preyVision") params.preyVision = std::clamp(static_cast<int>(value), 1, PredatorField::MAX_RANGE - 1);
+	else return false;
+	return true;
+}
 
-		std::uniform_int_distribution<> startX(0, screen_width);
-		std::uniform_int_distribution<> startY(0, screen_height);
-		for(int i=0; i<NUMBER_START_PTS; i++) {
-			olc::vi2d startPoint = olc::vi2d(startX(generator), startY(generator));
-			while(!walkable(startPoint) || !grid.farEnough(startPoint, points, INTER_PRED_R)) {
-				startPoint = olc::vi2d(startX(generator), startY(generator));
+// A whole file mapped read-only, so processes that open the same file share its
+// pages through the page cache. Windows reads the file into memory instead.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if(!in) return;
+		buffer.resize(static_cast<size_t>(in.tellg()));
+		in.seekg(0);
+		if(!in.read(buffer.data(), buffer.size())) return;
+		bytes = buffer.data();
+		length = buffer.size();
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0) return;
+		struct stat info;
+		if(fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapped != MAP_FAILED) {
+				bytes = static_cast<const char*>(mapped);
+				length = static_cast<size_t>(info.st_size);
 			}
+		}
+		// the mapping keeps the file open
+		::close(fd);
+#endif
+	}
+
+	~MappedFile() {
+#if !defined(_WIN32)
+		if(bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const { return bytes != nullptr; }
+
+	const char* data() const { return bytes; }
 
-			points.push_back(startPoint);
-			active.push_back(startPoint);
-			grid.insert(startPoint, i);
+	size_t size() const { return length; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+#if defined(_WIN32)
+	AlignedVector<char> buffer;
+#endif
+};
+
+// The start of a terrain cache file. The sections follow it, each at a 64 byte
+// aligned offset: the heights, land, land neighbour and colour grids byte for byte
+// as Grid2D lays them out, so they're used where they're mapped, then the world
+// generator's state. Everything the terrain is made from is in the header, and a
+// file is only used for a world that matches all of it.
+struct TerrainFileHeader {
+	static constexpr char MAGIC[8] = {'S', 'I', 'M', 'T', 'E', 'R', 'R', '\0'};
+	// bump when the terrain generation or the layout changes
+	static constexpr uint32_t VERSION = 2;
+	// reads back differently on a machine with the other byte order
+	static constexpr uint32_t ENDIAN_CHECK = 0x01020304;
+	enum Section { HEIGHTS, LAND, LAND_NEIGHBOURS, COLORS, GENERATOR, SECTIONS };
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t seed;
+	int32_t width;
+	int32_t height;
+	float roughnessDelta;
+	float oceanLim;
+	float beachLim;
+	float mountLim;
+	float snowLim;
+	int32_t terrainCell;
+	uint64_t offset[SECTIONS];
+	uint64_t size[SECTIONS];
+
+	bool sameWorld(const TerrainFileHeader& other) const {
+		return std::memcmp(magic, MAGIC, sizeof(magic)) == 0 && version == VERSION && byteOrder == ENDIAN_CHECK && seed == other.seed &&
+			width == other.width && height == other.height && roughnessDelta == other.roughnessDelta && oceanLim == other.oceanLim &&
+			beachLim == other.beachLim && mountLim == other.mountLim && snowLim == other.snowLim && terrainCell == other.terrainCell;
+	}
+
+	// names the file after the world, so a cache directory can hold many of them
+	std::string fileName() const {
+		uint64_t hash = mix64(seed ^ VERSION);
+		for(float value: {roughnessDelta, oceanLim, beachLim, mountLim, snowLim}) {
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			hash = mix64(hash ^ bits);
 		}
+		hash = mix64(hash ^ (static_cast<uint64_t>(static_cast<uint32_t>(width)) << 32 | static_cast<uint32_t>(height)));
+		char name[40];
+		snprintf(name, sizeof(name), "terrain-%016llx.bin", static_cast<unsigned long long>(hash));
+		return name;
+	}
+};
 
-		while(!active.empty()) {
-			//std::cout << active.size() << std::endl;
-			std::uniform_int_distribution<> randIndex(0, active.size() - 1);
-			int index = randIndex(generator);
-			olc::vi2d basePt = active[index];
-			bool valid = false;
+// A running world copied out between two ticks. The terrain isn't in it, only
+// what it's made from, since generating it again (or mapping it from the terrain
+// cache) gives it back exactly; the agents, the tick and the generator state are.
+struct Checkpoint {
+	static constexpr char MAGIC[8] = {'S', 'I', 'M', 'C', 'K', 'P', 'T', '\0'};
+	// bump when the blocks or anything in them change
+	static constexpr uint32_t VERSION = 1;
+
+	// the fixed size part, the first block of the file
+	struct World {
+		char magic[8];
+		uint32_t version;
+		// reads back differently on a machine with the other byte order
+		uint32_t endianCheck;
+		uint64_t seed;
+		int32_t width;
+		int32_t height;
+		uint32_t chunked;
+		SimParams params;
+		int64_t ticks;
+		uint64_t nextAgentId;
+	} world{};
+	// std::mt19937's text form
+	std::string generatorState;
+	PredatorStore predators;
+	PreyStore preys;
+};
+
+// Writes the checkpoint under a name of its own and renames it into place, so a
+// crash while writing leaves the last checkpoint whole; false if it couldn't.
+bool saveCheckpoint(const Checkpoint& checkpoint, const std::string& path) {
+	std::string temporary = path + "." + std::to_string(randomSeed()) + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary);
+		writeBlock(out, &checkpoint.world, sizeof(checkpoint.world));
+		writeBlock(out, checkpoint.generatorState.data(), checkpoint.generatorState.size());
+		checkpoint.predators.write(out);
+		checkpoint.preys.write(out);
+		out.close();
+		if(!out) {
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+	std::error_code error;
+	// std::rename won't replace a file on Windows
+	std::filesystem::rename(temporary, path, error);
+	if(error) std::remove(temporary.c_str());
+	return !error;
+}
 
-			for(int i=0; i<TEST_POINTS; i++) {
-				olc::vi2d randVect = randVector(basePt, INTER_PRED_R);
-				if(!walkable(randVect) || !grid.farEnough(randVect, points, INTER_PRED_R)) continue;
+// false if the file is missing, damaged or from another version
+bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+	std::ifstream in(path, std::ios::binary);
+	Checkpoint::World& world = checkpoint.world;
+	if(!readBlock(in, &world, sizeof(world)) || std::memcmp(world.magic, Checkpoint::MAGIC, sizeof(world.magic)) != 0 ||
+		world.version != Checkpoint::VERSION || world.endianCheck != TerrainFileHeader::ENDIAN_CHECK) return false;
+	uint64_t stateLength = 0;
+	if(!in.read(reinterpret_cast<char*>(&stateLength), sizeof(stateLength)) || stateLength > bytesLeft(in)) return false;
+	checkpoint.generatorState.resize(stateLength);
+	if(!in.read(checkpoint.generatorState.data(), stateLength)) return false;
+	if(!checkpoint.predators.read(in) || !checkpoint.preys.read(in)) return false;
+
+	// a file can hang together and still hold values restore() would trip over
+	if(world.width < 1 || world.height < 1) return false;
+	std::mt19937 generator;
+	std::istringstream state(checkpoint.generatorState);
+	if(!(state >> generator)) return false;
+	// chunked worlds have no edge, every other one's agents stand inside it
+	if(!world.chunked) {
+		auto inWorld = [&](const olc::vi2d& pos) { return pos.x >= 0 && pos.x < world.width && pos.y >= 0 && pos.y < world.height; };
+		if(!std::all_of(checkpoint.predators.pos.begin(), checkpoint.predators.pos.end(), inWorld) ||
+			!std::all_of(checkpoint.preys.pos.begin(), checkpoint.preys.pos.end(), inWorld)) return false;
+	}
+	return true;
+}
 
-				points.push_back(randVect);
-				active.push_back(randVect);
-				grid.insert(randVect, points.size() - 1);
+// Writes checkpoints on a thread of its own, so a run only stops for as long as
+// copying its state out takes. One is written at a time: a new checkpoint waits
+// for the last one to be on disk.
+class CheckpointWriter {
+public:
+	~CheckpointWriter() { wait(); }
 
-				valid = true;
-				break;
-			}
+	// starts writing once the previous checkpoint is on disk, false if that one failed
+	bool write(Checkpoint checkpoint, const std::string& path) {
+		bool previous = wait();
+		thread = std::thread([this, checkpoint = std::move(checkpoint), path]() { written = saveCheckpoint(checkpoint, path); });
+		return previous;
+	}
 
-			if(!valid) {
-				active[index] = active.back();
-				active.pop_back();
-			}
+	// waits for the checkpoint being written, true if it made it to disk; each
+	// failure is reported once, by whichever of write() or wait() comes next
+	bool wait() {
+		if(thread.joinable()) thread.join();
+		bool result = written;
+		written = true;
+		return result;
+	}
+
+private:
+	std::thread thread;
+	bool written = true;
+};
+
+// The world and its agents, without any window or rendering attached.
+// SparseEncodedLifeSim drives one of these for the interactive view, and
+// runHeadless() drives one at full speed from the command line.
+class Simulation
+{
+public:
+	Simulation(int worldWidth, int worldHeight, uint64_t worldSeed, const SimParams& worldParams = SimParams()) :
+		world_width(worldWidth), world_height(worldHeight), seed(worldSeed), params(worldParams),
+		OCEAN_LIM(params.oceanLim), BEACH_LIM(params.beachLim), MOUNT_LIM(params.mountLim), SNOW_LIM(params.snowLim),
+		INTER_PRED_R(params.interPredR), INTER_PREY_R(params.interPreyR), PRED_PREY_R(params.predPreyR) {
+		std::seed_seq seedSequence{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+		generator.seed(seedSequence);
+		predators.starvation = params.predatorStarvation;
+		preys.lifespan = params.preyLifespan;
+		// at least 2 x 2 squares, so how much of the world is land isn't up to a single
+		// corner, and squares no bigger than MAX_TERRAIN_CELL, so big worlds get the
+		// same feature sizes as the largest small one rather than one giant continent
+		while((2 << terrainShift) < std::min(world_width, world_height) - 1 && terrainShift < MAX_TERRAIN_SHIFT) terrainShift++;
+		terrainCell = 1 << terrainShift;
+	}
+
+	int getWorldWidth() { return world_width; }
+
+	int getWorldHeight() { return world_height; }
+
+	// builds a new world, reusing the agent slots of the last one if there was one
+	void generate() {
+		ScopedTimer timer("generate");
+		predators.clear();
+		preys.clear();
+		if(chunks) {
+			chunks->clear();
+			loadSpawnArea();
+		} else {
+			generateTerrain();
+		}
+
+		// preys.add(newAgentId(), olc::vi2d(20, 20), olc::Pixel(255, 255, 0));
+		// preys.add(newAgentId(), olc::vi2d(10, 5), olc::Pixel(0, 255, 0));
+		// predators.add(newAgentId(), olc::vi2d(0, 20), olc::Pixel(255, 0, 0));
+
+		poissonDiskSample();
+	}
+
+	// advances the world by one step, leaving the collections cleaned
+	void tick() {
+		ScopedTimer timer("tick");
+		updatePreys();
+		updatePredators();
+		cleanCollections(true, true);
+		if(chunks) chunks->trim(ticks);
+		ticks++;
+	}
+
+	long long getTicks() { return ticks; }
+
+	uint64_t getSeed() { return seed; }
+
+	// 0 keeps the classic serial prey update; 1 or more switches prey movement to
+	// the two-phase intent/resolve update spread over that many threads. For a
+	// given seed the two-phase update gives the same world for any thread count.
+	void setThreadCount(int threadCount) {
+		if(threadCount <= 0) {
+			workers.reset();
+		} else {
+			workers = std::make_unique<WorkerPool>(threadCount);
+		}
+	}
+
+	// Makes the world unbounded: land is generated in chunks as agents reach it, and
+	// chunks without agents are dropped once the loaded ones take more than
+	// budgetBytes. The world size then only sets where the first agents are spread.
+	// Call it before generate().
+	void useChunks(size_t budgetBytes) {
+		chunks = std::make_unique<ChunkedWorld>(budgetBytes, [this](ChunkedWorld::Chunk& chunk) { generateChunk(chunk); });
+	}
+
+	bool isChunked() { return chunks != nullptr; }
+
+	// Keeps the generated terrain in a file in dir and maps it back in, instead of
+	// generating it again, for any later world of the same seed, size and terrain
+	// parameters. Bounded worlds only; call it before generate().
+	void setTerrainCache(const std::string& dir) { terrainCacheDir = dir; }
+
+	// the cache file of the last terrain generated, empty without a cache
+	const std::string& getTerrainCacheFile() { return terrainCachePath; }
+
+	bool isTerrainFromCache() { return terrainMapped; }
+
+	// A copy of the world at this tick that goes on with branchParams, for what-if
+	// runs off one evolved population. Branches share the terrain, which nothing
+	// writes to once it's generated, and get their own agents, since every agent
+	// moves on the first tick anyway. Only the parameters that act during ticks
+	// (predatorStarvation, preyLifespan and preyVision) are taken from branchParams;
+	// the terrain and the starting spread stay this world's. A chunked world's
+	// branch generates the chunks it needs again. Forking only reads this world,
+	// so several threads can fork it at once.
+	std::unique_ptr<Simulation> fork(const SimParams& branchParams) const {
+		ScopedTimer timer("fork");
+		SimParams forkParams = params;
+		forkParams.predatorStarvation = branchParams.predatorStarvation;
+		forkParams.preyLifespan = branchParams.preyLifespan;
+		forkParams.preyVision = branchParams.preyVision;
+		auto branch = std::make_unique<Simulation>(world_width, world_height, seed, forkParams);
+		if(chunks) {
+			branch->useChunks(chunks->getBudget());
+		} else {
+			branch->terrain = terrain;
+			branch->land = land;
+			branch->landNeighbours = landNeighbours;
+			branch->terrainColors = terrainColors;
+			branch->terrainOwner = terrainOwner;
+			branch->terrainMapped = terrainMapped;
+			branch->terrainCachePath = terrainCachePath;
 		}
+		branch->predators = predators;
+		branch->preys = preys;
+		branch->predators.starvation = forkParams.predatorStarvation;
+		branch->preys.lifespan = forkParams.preyLifespan;
+		branch->ticks = ticks;
+		branch->nextAgentId = nextAgentId;
+		branch->generator = generator;
+		branch->rebuildOccupancy();
+		return branch;
+	}
 
-		for(const auto& point: points) {
-			olc::vi2d newPredPos = point;
-			predators.insert(std::make_unique<Predator>(point, olc::Pixel(255, 0, 0)));
+	// copies out everything restore() needs to carry on from this tick
+	Checkpoint checkpoint() {
+		ScopedTimer timer("checkpoint");
+		Checkpoint checkpoint;
+		Checkpoint::World& world = checkpoint.world;
+		std::memcpy(world.magic, Checkpoint::MAGIC, sizeof(world.magic));
+		world.version = Checkpoint::VERSION;
+		world.endianCheck = TerrainFileHeader::ENDIAN_CHECK;
+		world.seed = seed;
+		world.width = world_width;
+		world.height = world_height;
+		world.chunked = chunks != nullptr;
+		world.params = params;
+		world.ticks = ticks;
+		world.nextAgentId = nextAgentId;
+		std::ostringstream state;
+		state << generator;
+		checkpoint.generatorState = state.str();
+		checkpoint.predators = predators;
+		checkpoint.preys = preys;
+		return checkpoint;
+	}
+
+	// Carries on from a checkpoint instead of generating a new world: the terrain
+	// is made again and the agents, tick and generator put back, so the ticks that
+	// follow are the ones the checkpointed run would have had. The simulation must
+	// be made with the checkpoint's seed, size and parameters, chunked if it was.
+	void restore(const Checkpoint& checkpoint) {
+		ScopedTimer timer("restore");
+		if(chunks) {
+			chunks->clear();
+		} else {
+			generateTerrain();
 		}
+		predators = checkpoint.predators;
+		preys = checkpoint.preys;
+		ticks = checkpoint.world.ticks;
+		nextAgentId = checkpoint.world.nextAgentId;
+		std::istringstream state(checkpoint.generatorState);
+		state >> generator;
 		rebuildOccupancy();
-		return std::make_pair(points, grid);
 	}
-	
-	void generatePrey(std::vector<olc::vi2d> predPoints, SpacialHash predGrid) {
-		std::vector<olc::vi2d> preyPoints;
-		std::vector<olc::vi2d> preyActive;
 
-		// the r/sqrt(2) grid for O(N) neighbor checking
-		SpacialHash grid(INTER_PREY_R);
+	ChunkedWorld::Stats getChunkStats() { return chunks ? chunks->stats() : ChunkedWorld::Stats(); }
+
+	const PredatorStore& getPredators() { return predators; }
+
+	const PreyStore& getPreys() { return preys; }
+
+	const Grid2D<float>& getTerrain() { return terrain; }
+
+	landType getLand(olc::vi2d cell) {
+		if(chunks) return landAt(cell);
+		return land.inBounds(cell) ? land[cell] : landType::NONE;
+	}
+
+	// only the app draws the terrain, so the sprite is made the first time it's asked for
+	olc::Sprite* getTerrainSprite() {
+		if(!terrainSprite) {
+			terrainSprite = std::make_unique<olc::Sprite>(world_width, world_height);
+			for(int y = 0; y < world_height; y++) {
+				for(int x = 0; x < world_width; x++) {
+					uint32_t color = terrainColorAt(olc::vi2d(x, y));
+					terrainSprite->SetPixel(x, y, olc::Pixel(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, 200));
+				}
+			}
+		}
+		return terrainSprite.get();
+	}
+
+protected:
+	PredatorStore predators;
+	PreyStore preys;
+	// maintained incrementally on every move, birth and death
+	OccupancyGrid occupancy;
+	// rebuilt at the start of every prey update
+	PredatorField predatorField;
+
+	// only set for an unbounded world, which keeps its land and occupancy in here
+	// and its predator field in sparseField instead
+	std::unique_ptr<ChunkedWorld> chunks;
+	SparsePredatorField sparseField;
+	// heights of the chunk being generated, and the lattice of one noise octave over it
+	Grid2D<float> chunkHeights;
+	std::vector<float> chunkLattice;
+
+	// one height per world cell
+	Grid2D<float> terrain;
+	// with a one cell ocean border, so walkable() can look at every neighbour of a world cell
+	Grid2D<landType> land;
+	// which neighbours of every world cell are land, as a NEIGHBOURS bit mask; agents
+	// narrow it down to the free ones with the occupancy grid
+	Grid2D<uint8_t> landNeighbours;
+
+	std::unique_ptr<olc::Sprite> terrainSprite;
+	// r | g << 8 | b << 16 of every cell's ground colour
+	Grid2D<uint32_t> terrainColors;
+
+	std::string terrainCacheDir;
+	std::string terrainCachePath;
+	// Once generated the terrain grids only view their cells, which this keeps
+	// alive: the mapped cache file, or a TerrainGrids that forks of the world share.
+	std::shared_ptr<const void> terrainOwner;
+	bool terrainMapped = false;
+
+	// the grids of a generated terrain, held apart from the simulation so its forks can share them
+	struct TerrainGrids {
+		Grid2D<float> terrain;
+		Grid2D<landType> land;
+		Grid2D<uint8_t> landNeighbours;
+		Grid2D<uint32_t> colors;
+	};
+
+	int world_width = 0;
+	int world_height = 0;
+	// side of the squares the diamond-square starts from, and of the lattice of the
+	// unbounded world's strongest noise octave
+	int terrainShift = 0;
+	int terrainCell = 1;
+	long long ticks = 0;
+	uint64_t seed;
+	uint64_t nextAgentId = 0;
+	SimParams params;
+
+	float const OCEAN_LIM;
+	float const BEACH_LIM;
+	float const MOUNT_LIM;
+	float const SNOW_LIM;
+	float const INTER_PRED_R;
+	float const INTER_PREY_R;
+	float const PRED_PREY_R;
+	int const NUMBER_START_PTS = 5;
+	static constexpr int MAX_TERRAIN_SHIFT = 10;
+	static constexpr int MAX_TERRAIN_CELL = 1 << MAX_TERRAIN_SHIFT;
+	// this is how many random vectors will be generated and tested for an active point before inactivated
+	const int TEST_POINTS = 10;
 
+	// Standard mersenne_twister_engine seeded from the world seed, only used while
+	// generating the world; agents draw from an AgentRng during ticks
+	std::mt19937 generator;
 
-		std::uniform_int_distribution<> startX(0, screen_width);
-		std::uniform_int_distribution<> startY(0, screen_height);
-		for(int i=0; i<NUMBER_START_PTS; i++) {
-			olc::vi2d startPoint = olc::vi2d(startX(generator), startY(generator));
-			while(!walkable(startPoint) || !grid.farEnough(startPoint, preyPoints, INTER_PREY_R) || !predGrid.farEnough(startPoint, predPoints, PRED_PREY_R)) {
-				startPoint = olc::vi2d(startX(generator), startY(generator));
-			}
+	// only set when prey movement runs in parallel
+	std::unique_ptr<WorkerPool> workers;
+	// the cell each prey wants to move to this tick
+	std::vector<olc::vi2d> preyIntents;
 
-			preyPoints.push_back(startPoint);
-			preyActive.push_back(startPoint);
-			grid.insert(startPoint, i);
+
+	void generateTerrain() {
+		if(!terrainCacheDir.empty()) {
+			terrainCachePath = (std::filesystem::path(terrainCacheDir) / terrainKey().fileName()).string();
+			if(loadTerrain()) return;
 		}
+		makeTerrain(params.roughnessDelta);
+		cacheTerrain();
+		shareTerrain();
+		if(!terrainCacheDir.empty()) saveTerrain();
+	}
 
-		while(!preyActive.empty()) {
-			//std::cout << active.size() << std::endl;
-			std::uniform_int_distribution<> randIndex(0, preyActive.size() - 1);
-			int index = randIndex(generator);
-			olc::vi2d basePt = preyActive[index];
-			bool valid = false;
+	// moves the grids cacheTerrain() made into a TerrainGrids and views them there
+	void shareTerrain() {
+		auto grids = std::make_shared<TerrainGrids>();
+		grids->terrain = std::move(terrain);
+		grids->land = std::move(land);
+		grids->landNeighbours = std::move(landNeighbours);
+		grids->colors = std::move(terrainColors);
+		terrain.view(grids->terrain.data(), world_width, world_height);
+		land.view(grids->land.data(), world_width, world_height, 1);
+		landNeighbours.view(grids->landNeighbours.data(), world_width, world_height);
+		terrainColors.view(grids->colors.data(), world_width, world_height);
+		// only now is the last terrain no longer viewed
+		terrainOwner = std::move(grids);
+		terrainMapped = false;
+	}
 
-			for(int i=0; i<TEST_POINTS+5; i++) {
-				olc::vi2d randVect = randVector(basePt, INTER_PRED_R);
-				if(!walkable(randVect) || !grid.farEnough(randVect, preyPoints, INTER_PREY_R) || !predGrid.farEnough(randVect, predPoints, PRED_PREY_R)) continue;
+	// the header of this world's terrain cache file, bar the sections
+	TerrainFileHeader terrainKey() {
+		TerrainFileHeader header{};
+		std::memcpy(header.magic, TerrainFileHeader::MAGIC, sizeof(header.magic));
+		header.version = TerrainFileHeader::VERSION;
+		header.byteOrder = TerrainFileHeader::ENDIAN_CHECK;
+		header.seed = seed;
+		header.width = world_width;
+		header.height = world_height;
+		header.roughnessDelta = params.roughnessDelta;
+		header.oceanLim = OCEAN_LIM;
+		header.beachLim = BEACH_LIM;
+		header.mountLim = MOUNT_LIM;
+		header.snowLim = SNOW_LIM;
+		header.terrainCell = terrainCell;
+		return header;
+	}
 
-				preyPoints.push_back(randVect);
-				preyActive.push_back(randVect);
-				grid.insert(randVect, preyPoints.size() - 1);
+	// Points the terrain grids into the cache file and picks the generator up where
+	// generating the terrain left it; false when there's no usable file.
+	bool loadTerrain() {
+		auto file = std::make_shared<const MappedFile>(terrainCachePath);
+		if(!file->isOpen() || file->size() < sizeof(TerrainFileHeader)) return false;
+		TerrainFileHeader header;
+		std::memcpy(&header, file->data(), sizeof(header));
+		if(!header.sameWorld(terrainKey())) return false;
+
+		size_t gridBytes[] = {Grid2D<float>::layoutBytes(world_width, world_height), Grid2D<landType>::layoutBytes(world_width, world_height, 1),
+			Grid2D<uint8_t>::layoutBytes(world_width, world_height), Grid2D<uint32_t>::layoutBytes(world_width, world_height)};
+		for(int section = 0; section < TerrainFileHeader::SECTIONS; section++) {
+			if(header.offset[section] % 64 != 0 || header.offset[section] > file->size() || header.size[section] > file->size() - header.offset[section]) return false;
+			if(section != TerrainFileHeader::GENERATOR && header.size[section] != gridBytes[section]) return false;
+		}
+		std::istringstream state(std::string(file->data() + header.offset[TerrainFileHeader::GENERATOR], header.size[TerrainFileHeader::GENERATOR]));
+		std::mt19937 restored;
+		if(!(state >> restored)) return false;
+
+		const char* bytes = file->data();
+		terrain.view(reinterpret_cast<const float*>(bytes + header.offset[TerrainFileHeader::HEIGHTS]), world_width, world_height);
+		land.view(reinterpret_cast<const landType*>(bytes + header.offset[TerrainFileHeader::LAND]), world_width, world_height, 1);
+		landNeighbours.view(reinterpret_cast<const uint8_t*>(bytes + header.offset[TerrainFileHeader::LAND_NEIGHBOURS]), world_width, world_height);
+		terrainColors.view(reinterpret_cast<const uint32_t*>(bytes + header.offset[TerrainFileHeader::COLORS]), world_width, world_height);
+		generator = restored;
+		terrainSprite.reset();
+		terrainOwner = std::move(file);
+		terrainMapped = true;
+		return true;
+	}
 
-				valid = true;
-				break;
-			}
+	// Writes the file under a name of its own and renames it into place, so other
+	// processes sharing the cache never map half a file. Failing to write only
+	// leaves the terrain uncached.
+	void saveTerrain() {
+		std::ostringstream state;
+		state << generator;
+		std::string generatorState = state.str();
+
+		TerrainFileHeader header = terrainKey();
+		const char* sections[] = {reinterpret_cast<const char*>(terrain.data()), reinterpret_cast<const char*>(land.data()),
+			reinterpret_cast<const char*>(landNeighbours.data()), reinterpret_cast<const char*>(terrainColors.data()), generatorState.data()};
+		size_t sizes[] = {terrain.sizeBytes(), land.sizeBytes(), landNeighbours.sizeBytes(), terrainColors.sizeBytes(), generatorState.size()};
+		uint64_t offset = (sizeof(header) + 63) & ~uint64_t(63);
+		for(int section = 0; section < TerrainFileHeader::SECTIONS; section++) {
+			header.offset[section] = offset;
+			header.size[section] = sizes[section];
+			offset = (offset + sizes[section] + 63) & ~uint64_t(63);
+		}
 
-			if(!valid) {
-				preyActive[index] = preyActive.back();
-				preyActive.pop_back();
-			}
+		std::error_code error;
+		std::filesystem::create_directories(terrainCacheDir, error);
+		std::string temporary = terrainCachePath + "." + std::to_string(randomSeed()) + ".tmp";
+		std::ofstream out(temporary, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		static const char zeros[64] = {};
+		uint64_t written = sizeof(header);
+		for(int section = 0; section < TerrainFileHeader::SECTIONS && out; section++) {
+			out.write(zeros, header.offset[section] - written);
+			out.write(sections[section], sizes[section]);
+			written = header.offset[section] + sizes[section];
 		}
-		for(const auto& point: preyPoints) {
-			olc::vi2d newPredPos = point;
-			std::uniform_int_distribution<> randColor(0, 255);
-			preys.insert(std::make_unique<Prey>(point, olc::Pixel(randColor(generator), randColor(generator), randColor(generator))));
+		out.close();
+		if(!out || std::rename(temporary.c_str(), terrainCachePath.c_str()) != 0) {
+			std::remove(temporary.c_str());
+			if(!std::filesystem::exists(terrainCachePath, error)) std::cerr << "couldn't write the terrain cache " << terrainCachePath << std::endl;
 		}
-		rebuildOccupancy();
 	}
-	
+
+	// spreads the starting predators and preys over the land, predators first;
+	// in tiles on the workers when there are any
 	void poissonDiskSample() {
-		std::pair<std::vector<olc::vi2d>, SpacialHash> predResult = generatePredators();
-		generatePrey(predResult.first, predResult.second);
+		PoissonDiskSampler sampler(world_width, world_height,
+			{{INTER_PRED_R, TEST_POINTS, NUMBER_START_PTS}, {INTER_PRED_R, TEST_POINTS + 5, NUMBER_START_PTS}},
+			{{INTER_PRED_R, PRED_PREY_R}, {PRED_PREY_R, INTER_PREY_R}});
+		auto onLand = [this](olc::vi2d cell) { return landAt(cell) != landType::OCEAN; };
+		std::vector<std::vector<olc::vi2d>> points = workers ? sampler.sampleTiled(seed, *workers, onLand) : sampler.sample(generator, onLand);
+
+		for(const auto& point: points[0]) {
+			predators.add(newAgentId(), point, olc::Pixel(255, 0, 0));
+		}
+		std::uniform_int_distribution<> randColor(0, 255);
+		for(const auto& point: points[1]) {
+			preys.add(newAgentId(), point, olc::Pixel(randColor(generator), randColor(generator), randColor(generator)));
+		}
+		rebuildOccupancy();
 	}
 	
+	// The random nudge of one cell, uniform in [-roughness, roughness]. It's a pure
+	// function of the seed, the cell and the level (v), so the cells of a phase can be
+	// filled in any order, on any thread.
+	float terrainNoise(int i, int j, int v, float roughness) {
+		uint64_t cell = (static_cast<uint64_t>(i) << 32) | static_cast<uint32_t>(j);
+		uint64_t hash = mix64(seed ^ mix64(cell ^ mix64(static_cast<uint64_t>(v))));
+		return ((hash >> 40) * (2.0f / 16777216.0f) - 1.0f) * roughness;
+	}
+
 	void fixedAvg(int i, int j, int v, float roughness, int (&offsets)[4][2])
 	{
 		float sum = 0.0f;
@@ -435,19 +2513,37 @@ protected:
 		{
 			int x = i + offset[0] * v;
 			int y = j + offset[1] * v;
-			if (0 <= x && x < terrainSize && 0 <= y && y < terrainSize)
+			if (terrain.inBounds(olc::vi2d(x, y)))
 			{
-				sum += terrain[x][y];
+				sum += terrain(x, y);
 				count++;
 			}
 		}
 
-		std::uniform_real_distribution<float> randomness(-roughness, roughness);
-		terrain[i][j] = ((sum / static_cast<float>(count)) + randomness(generator));
+		terrain(i, j) = ((sum / static_cast<float>(count)) + terrainNoise(i, j, v, roughness));
 	}
 
+	// runs row(r) for every r in [0, count), split over the workers when there are any;
+	// rows must not write to each other's cells
+	void forEachRow(size_t count, const std::function<void(size_t)>& row) {
+		if(!workers) {
+			for(size_t r = 0; r < count; r++) row(r);
+			return;
+		}
+		workers->parallelFor(count, [&row](size_t begin, size_t end, int) {
+			for(size_t r = begin; r < end; r++) row(r);
+		});
+	}
+
+	// Every cell of a phase only reads cells set by earlier phases, so each phase
+	// runs in parallel, a row of cells per task. The squares cover the grid exactly,
+	// so only edge midpoints on its outer edge have a neighbour missing, and average
+	// the three they have.
 	void diamondSquareStep(int cellLen, float roughness)
 	{
+		int width = terrain.getWidth();
+		int height = terrain.getHeight();
+
 		// distance from new cell to nbs to average over
 		int v = std::floor(cellLen / 2);
 
@@ -455,49 +2551,50 @@ protected:
 		int diamondOffsets[4][2] = {{-1, -1}, {-1, 1}, {1, 1}, {1, -1}};
 		int squareOffsets[4][2] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
 
-		// Diamond Step
-		for (int i = v; i < terrainSize; i += cellLen)
-		{
-			for (int j = v; j < terrainSize; j += cellLen)
+		// Diamond Step: the centre of every square
+		forEachRow(height > v ? (height - 1 - v) / cellLen + 1 : 0, [&](size_t row) {
+			int j = v + static_cast<int>(row) * cellLen;
+			for (int i = v; i < width; i += cellLen)
 			{
 				fixedAvg(i, j, v, roughness, diamondOffsets);
 			}
-		}
+		});
 
-		// Square Step with rows
-		for (int i = v; i < terrainSize; i += cellLen)
-		{
-			for (int j = 0; j < terrainSize; j += cellLen)
+		// Square Step: the middle of every edge, the rows through the centres
+		// have them between the centres, the others between the corners
+		forEachRow((height - 1) / v + 1, [&](size_t row) {
+			int j = static_cast<int>(row) * v;
+			for (int i = row % 2 == 1 ? 0 : v; i < width; i += cellLen)
 			{
 				fixedAvg(i, j, v, roughness, squareOffsets);
 			}
-		}
+		});
+	}
 
-		// Square Step with columns
-		for (int i = 0; i < terrainSize; i += cellLen)
+	// the corners of the starting squares, anywhere in [-1, 1]
+	void initCorners(int cellLen)
+	{
+		for (int j = 0; j < terrain.getHeight(); j += cellLen)
 		{
-			for (int j = v; j < terrainSize; j += cellLen)
+			for (int i = 0; i < terrain.getWidth(); i += cellLen)
 			{
-				fixedAvg(i, j, v, roughness, squareOffsets);
+				terrain(i, j) = terrainNoise(i, j, cellLen, 1.0f);
 			}
 		}
 	}
 
-	void initCorners(int arrSize)
-	{
-		terrain[0][0] = 0.0f;
-		terrain[0][arrSize - 1] = 0.0f;
-		terrain[arrSize - 1][0] = 0.0f;
-		terrain[arrSize - 1][arrSize - 1] = 0.0f;
-	}
-
+	// Diamond-square over whole squares covering the world, however rectangular it
+	// is, cut down to exactly the world's cells. Squares hanging over the right or
+	// bottom edge still get all four corners, so no part of the world hangs off a
+	// single one.
 	void makeTerrain(float roughnessDelta)
 	{
-		terrain.clear();
-		terrain.resize(terrainSize, std::vector<float>(terrainSize, 0));
-		initCorners(terrainSize);
+		int width = (world_width + terrainCell - 2) / terrainCell * terrainCell + 1;
+		int height = (world_height + terrainCell - 2) / terrainCell * terrainCell + 1;
+		terrain.reset(width, height, 0.0f);
+		initCorners(terrainCell);
 
-		int cellLen = terrainSize - 1;
+		int cellLen = terrainCell;
 		float roughness = 1.0;
 
 		while (cellLen > 1)
@@ -508,136 +2605,234 @@ protected:
 			roughness *= roughnessDelta;
 		}
 
+		if(width != world_width || height != world_height) {
+			Grid2D<float> worldTerrain(world_width, world_height);
+			for(int j = 0; j < world_height; j++) {
+				std::copy(terrain.row(j), terrain.row(j) + world_width, worldTerrain.row(j));
+			}
+			terrain = std::move(worldTerrain);
+		}
+
 		// printTerrainArray();
 	}
 
 	void printTerrainArray()
 	{
-		for (auto &row : terrain)
+		for (int j = 0; j < terrain.getHeight(); j++)
 		{
-			for (float value : row)
+			for (int i = 0; i < terrain.getWidth(); i++)
 			{
-				std::cout << value << " ";
+				std::cout << terrain(i, j) << " ";
 			}
 			std::cout << std::endl;
 		}
 	}
 
-	void displayTerrain(bool usingOld = false)
-	{
-		if (!usingOld)
-		{
-			if (!terrainDecal)
-				return;
 
-			tv.DrawDecal({0, 0}, terrainDecal.get(), {1.0f, 1.0f});
+	// One octave of the unbounded world's noise at a cell: the four lattice values
+	// around it, 2^shift cells apart, blended with a smoothstep.
+	static float blendLattice(float v00, float v10, float v01, float v11, int x, int y, int shift) {
+		float cell = static_cast<float>(1 << shift);
+		float fx = (x & ((1 << shift) - 1)) / cell;
+		float fy = (y & ((1 << shift) - 1)) / cell;
+		fx = fx * fx * (3.0f - 2.0f * fx);
+		fy = fy * fy * (3.0f - 2.0f * fy);
+		float top = v00 + (v10 - v00) * fx;
+		float bottom = v01 + (v11 - v01) * fx;
+		return top + (bottom - top) * fy;
+	}
+
+	float latticeValue(int gx, int gy, int shift) { return terrainNoise(gx, gy, 1 << shift, 1.0f); }
+
+	// Height of any cell of the unbounded world: octaves of hashed lattice values
+	// from terrainCell apart down to 2, each roughnessDelta times as strong as the
+	// one before, like the levels of the diamond-square. Like the squares of a
+	// bounded world, the strongest octave's lattice is small enough for the spawn
+	// area to span several of its values. generateChunk() adds up the same octaves
+	// in the same order for a whole chunk at once.
+	float noiseHeight(int x, int y) {
+		float height = 0.0f;
+		float amplitude = 1.0f;
+		for(int shift = std::max(terrainShift, 1); shift >= 1; shift--) {
+			int gx = x >> shift;
+			int gy = y >> shift;
+			height += amplitude * blendLattice(latticeValue(gx, gy, shift), latticeValue(gx + 1, gy, shift),
+				latticeValue(gx, gy + 1, shift), latticeValue(gx + 1, gy + 1, shift), x, y, shift);
+			amplitude *= params.roughnessDelta;
 		}
-		else
-		{
+		return height;
+	}
 
-			int rows = std::ceil(static_cast<float>(screen_width) / 10);
-			int columns = std::ceil(static_cast<float>(screen_height) / 10);
-			for (int i = 0; i < rows; i++)
-			{
-				for (int j = 0; j < columns; j++)
-				{
-					int luminosity = std::clamp(static_cast<int>(std::abs(terrain[i][j]) * 255), 0, 255);
-					tv.FillRectDecal(olc::vi2d(i, j), olc::vi2d(1, 1), olc::Pixel(luminosity, luminosity, luminosity));
+	// the speckle of a beach cell in the unbounded world, in [0, 1)
+	float beachRandom(olc::vi2d cell) {
+		return (mix64(seed ^ mix64(packCell(cell) ^ 0xBEAC4ull)) >> 40) * (1.0f / 16777216.0f);
+	}
+
+	// fills a chunk of the unbounded world from the noise, the land of its border included
+	void generateChunk(ChunkedWorld::Chunk& chunk) {
+		ScopedTimer timer("generateChunk");
+		const int size = ChunkedWorld::CHUNK_SIZE;
+		olc::vi2d origin = chunk.coord * size;
+
+		chunkHeights.reset(size, size, 0.0f, 1);
+		float amplitude = 1.0f;
+		for(int shift = std::max(terrainShift, 1); shift >= 1; shift--) {
+			int gx0 = (origin.x - 1) >> shift;
+			int gy0 = (origin.y - 1) >> shift;
+			int columns = ((origin.x + size) >> shift) - gx0 + 2;
+			int rows = ((origin.y + size) >> shift) - gy0 + 2;
+			chunkLattice.resize(static_cast<size_t>(columns) * rows);
+			for(int j = 0; j < rows; j++) {
+				for(int i = 0; i < columns; i++) {
+					chunkLattice[static_cast<size_t>(j) * columns + i] = latticeValue(gx0 + i, gy0 + j, shift);
 				}
 			}
+			for(int y = -1; y <= size; y++) {
+				int cy = origin.y + y;
+				size_t row = static_cast<size_t>((cy >> shift) - gy0) * columns;
+				for(int x = -1; x <= size; x++) {
+					int cx = origin.x + x;
+					const float* top = &chunkLattice[row + ((cx >> shift) - gx0)];
+					const float* bottom = top + columns;
+					chunkHeights(x, y) += amplitude * blendLattice(top[0], top[1], bottom[0], bottom[1], cx, cy, shift);
+				}
+			}
+			amplitude *= params.roughnessDelta;
+		}
+
+		chunk.land.reset(size, size, landType::OCEAN, 1);
+		chunk.landNeighbours.reset(size, size);
+		chunk.colors.reset(size, size);
+		chunk.occupancy.reset(size, size, OccupancyGrid::EMPTY);
+		for(int y = -1; y <= size; y++) {
+			for(int x = -1; x <= size; x++) {
+				olc::vi2d cell(origin.x + x, origin.y + y);
+				olc::Pixel color;
+				chunk.land(x, y) = classifyTerrain(chunkHeights(x, y), [&]() { return beachRandom(cell); }, color);
+				if(chunk.colors.inBounds(olc::vi2d(x, y))) chunk.colors(x, y) = packColor(color);
+			}
+		}
+		for(int y = 0; y < size; y++) {
+			for(int x = 0; x < size; x++) {
+				uint8_t mask = 0;
+				for(int k = 0; k < 8; k++) {
+					if(chunk.land(x + NEIGHBOURS[k].dx, y + NEIGHBOURS[k].dy) != landType::OCEAN) mask |= 1 << k;
+				}
+				chunk.landNeighbours(x, y) = mask;
+			}
+		}
+	}
+
+	// the chunks the first agents are spread over, so the sampler's threads only read
+	void loadSpawnArea() {
+		olc::vi2d first = ChunkedWorld::chunkOf(olc::vi2d(0, 0));
+		olc::vi2d last = ChunkedWorld::chunkOf(olc::vi2d(world_width - 1, world_height - 1));
+		for(int cy = first.y; cy <= last.y; cy++) {
+			for(int cx = first.x; cx <= last.x; cx++) {
+				chunks->load(olc::vi2d(cx, cy) * ChunkedWorld::CHUNK_SIZE);
+			}
+		}
+	}
+
+	// The biome of a height and the colour of its ground. Beaches are speckled,
+	// with beachRandom() giving a number in [0, 1) for each beach cell.
+	template <typename BeachRandom>
+	landType classifyTerrain(float height, BeachRandom beachRandom, olc::Pixel& color)
+	{
+		// --- OCEAN DIVIDER --- //
+		if (height < OCEAN_LIM)
+		{
+			float value = (height + 1) / (OCEAN_LIM + 1);
+			int darkBlue[3] = {0, 0, 53};
+			int lightBlue[3] = {135, 206, 250};
+
+			int r = int(darkBlue[0] + value * (lightBlue[0] - darkBlue[0]));
+			int g = int(darkBlue[1] + value * (lightBlue[1] - darkBlue[1]));
+			int b = int(darkBlue[2] + value * (lightBlue[2] - darkBlue[2]));
+			color = olc::Pixel(r, g, b, 200);
+			return landType::OCEAN;
+		}
+		// --- BEACH BIOM --- //
+		else if (height >= OCEAN_LIM && height <= BEACH_LIM)
+		{
+			float value = beachRandom();
+			int r = 255;
+    				int g = 200 + static_cast<int>(55 * value);
+    				int b = static_cast<int>(20.0 * (1.0 - value));
+			color = olc::Pixel(r, g, b, 200);
+			return landType::BEACH;
+		// --- MOUNTAIN BIOM --- //
+		} else if(height > MOUNT_LIM && height < SNOW_LIM) {
+			float value = height / MOUNT_LIM;
+			int darkGrey[3] = {51, 51, 51};
+			int lightGrey[3] = {170, 170, 170};
+
+			int r = int(darkGrey[0] + value * (lightGrey[0] - darkGrey[0]));
+			int g = int(darkGrey[1] + value * (lightGrey[1] - darkGrey[1]));
+			int b = int(darkGrey[2] + value * (lightGrey[2] - darkGrey[2]));
+			color = olc::Pixel(r, g, b, 200);
+			return landType::MOUNTAIN;
+		// --- SNOW BIOM --- //
+		} else if(height >= SNOW_LIM) {
+			color = olc::Pixel(255, 250, 250, 200);
+			return landType::SNOW;
+		// --- FORREST BIOM --- //
+		} else {
+			float value = height / MOUNT_LIM;
+			int darkGreen[3] = {0, 100, 0};
+			int lightGreen[3] = {0, 186, 0};
+
+			int r = int(darkGreen[0] + value * (lightGreen[0] - darkGreen[0]));
+			int g = int(darkGreen[1] + value * (lightGreen[1] - darkGreen[1]));
+			int b = int(darkGreen[2] + value * (lightGreen[2] - darkGreen[2]));
+			color = olc::Pixel(r, g, b, 200);
+			return landType::FOREST;
 		}
 	}
 
 	void cacheTerrain()
 	{
-		int rows = std::ceil(static_cast<float>(screen_width) / 10);
-		int columns = std::ceil(static_cast<float>(screen_height) / 10);
+		int rows = world_width;
+		int columns = world_height;
 
-		land.clear();
-		land.resize(rows, std::vector<landType>(columns, landType::NONE));
+		// every cell of the world is set below, which leaves the border as ocean
+		land.reset(rows, columns, landType::OCEAN, 1);
 
-		terrainSprite.reset(new olc::Sprite(rows, columns));
+		terrainSprite.reset();
+		terrainColors.reset(rows, columns);
 
-		for (int i = 0; i < rows; i++)
+		for (int j = 0; j < columns; j++)
 		{
-			for (int j = 0; j < columns; j++)
+			for (int i = 0; i < rows; i++)
 			{
-				int luminosity = /*std::clamp()*/ static_cast<int>(terrain[i][j] * 255) /*, 0, 255)*/;
-				// --- OCEAN DIVIDER --- //
-				if (terrain[i][j] < OCEAN_LIM)
-				{
-					float value = (terrain[i][j] + 1) / (OCEAN_LIM + 1);
-					int darkBlue[3] = {0, 0, 53};
-					int lightBlue[3] = {135, 206, 250};
-
-					int r = int(darkBlue[0] + value * (lightBlue[0] - darkBlue[0]));
-					int g = int(darkBlue[1] + value * (lightBlue[1] - darkBlue[1]));
-					int b = int(darkBlue[2] + value * (lightBlue[2] - darkBlue[2]));
-					terrainSprite->SetPixel(i, j, olc::Pixel(r, g, b, 200));
-					land[i][j] = landType::OCEAN;
-				}
-				// --- BEACH BIOM --- //
-				else if (terrain[i][j] >= OCEAN_LIM && terrain[i][j] <= BEACH_LIM)
-				{
+				olc::Pixel color;
+				land(i, j) = classifyTerrain(terrain(i, j), [this]() {
 					std::uniform_real_distribution<float> randomness(0, 1);
-					float value = randomness(generator);
-					int r = 255;
-    				int g = 200 + static_cast<int>(55 * value);
-    				int b = static_cast<int>(20.0 * (1.0 - value));
-					terrainSprite->SetPixel(i, j, olc::Pixel(r, g, b, 200));
-					land[i][j] = landType::BEACH;
-				// --- MOUNTAIN BIOM --- //
-				} else if(terrain[i][j] > MOUNT_LIM && terrain[i][j] < SNOW_LIM) {
-					float value = terrain[i][j] / MOUNT_LIM;
-					int darkGrey[3] = {51, 51, 51};
-					int lightGrey[3] = {170, 170, 170};
-
-					int r = int(darkGrey[0] + value * (lightGrey[0] - darkGrey[0]));
-					int g = int(darkGrey[1] + value * (lightGrey[1] - darkGrey[1]));
-					int b = int(darkGrey[2] + value * (lightGrey[2] - darkGrey[2]));
-					terrainSprite->SetPixel(i, j, olc::Pixel(r, g, b, 200));
-					land[i][j] = landType::MOUNTAIN;
-				// --- SNOW BIOM --- //
-				} else if(terrain[i][j] >= SNOW_LIM) {
-					terrainSprite->SetPixel(i, j, olc::Pixel(255, 250, 250, 200));
-					land[i][j] = landType::SNOW;
-				// --- FORREST BIOM --- //
-				} else {
-					float value = terrain[i][j] / MOUNT_LIM;
-					int darkGreen[3] = {0, 100, 0};
-					int lightGreen[3] = {0, 186, 0};
-
-					int r = int(darkGreen[0] + value * (lightGreen[0] - darkGreen[0]));
-					int g = int(darkGreen[1] + value * (lightGreen[1] - darkGreen[1]));
-					int b = int(darkGreen[2] + value * (lightGreen[2] - darkGreen[2]));
-					terrainSprite->SetPixel(i, j, olc::Pixel(r, g, b, 200));
-					land[i][j] = landType::FOREST;
+					return randomness(generator);
+				}, color);
+				setTerrainColor(i, j, color);
+			}
+		}
+
+		landNeighbours.reset(rows, columns);
+		for (int j = 0; j < columns; j++)
+		{
+			for (int i = 0; i < rows; i++)
+			{
+				uint8_t mask = 0;
+				for (int k = 0; k < 8; k++)
+				{
+					if (land(i + NEIGHBOURS[k].dx, j + NEIGHBOURS[k].dy) != landType::OCEAN) mask |= 1 << k;
 				}
+				landNeighbours(i, j) = mask;
 			}
 		}
-		terrainDecal.reset(new olc::Decal(terrainSprite.get()));
 	}
 	
 	olc::vi2d stepTowords(olc::vi2d from, olc::vi2d to, bool forPred=true) {
-		//olc::vi2d delta = from - to;
-		std::vector<olc::vi2d> possibleMovements;
-
-		for(int i=-1; i<=1; i++) {
-			for(int j=-1; j<=1; j++) {
-				if(i == 0 && j == 0) continue;
-				if(forPred) {
-					if(walkable(olc::vi2d(from.x + i, from.y + j), true)) {
-						possibleMovements.push_back(olc::vi2d(from.x + i, from.y + j));
-					}
-				} else {
-					if(walkable(olc::vi2d(from.x + i, from.y + j))) {
-						possibleMovements.push_back(olc::vi2d(from.x + i, from.y + j));
-					}
-				}
-			}
-		}
+		MoveCandidates possibleMovements(from, forPred ? huntableNeighbours(from) : freeNeighbours(from), false);
 
-		if(possibleMovements.size() == 0) {return from;}
+		if(possibleMovements.empty()) {return from;}
 
 		int best = 0;
 		for(int i=0; i<possibleMovements.size(); i++) {
@@ -647,55 +2842,87 @@ protected:
 		}
 
 		return possibleMovements[best];
-		// return olc::vi2d(
-		// 	delta.x == 0 ? 0 : delta.x > 0 ? 1 : -1,
-		// 	delta.y == 0 ? 0 : delta.y > 0 ? 1 : -1
-		// );
 	}
 
-	int colorDiff(olc::Pixel color1, olc::Pixel color2) {
-		return std::floor(static_cast<float>(abs(color1.r - color2.r) + abs(color1.g - color2.g) + abs(color1.b - color2.b)) / 3.0);
+	void setTerrainColor(int x, int y, olc::Pixel color) {
+		terrainColors(x, y) = packColor(color);
 	}
-	
-	olc::vi2d avoidPredators(olc::vi2d pos, olc::vi2d prevPos, olc::Pixel color) {
-		std::vector<olc::vi2d> possibleMovements;
-		std::vector<olc::vi2d> preds;
-
-		for(int i=-1; i<=1; i++) {
-			for(int j=-1; j<=1; j++) {
-				if(i == 0 && j == 0) continue;
-				olc::vi2d possiblePos = olc::vi2d(pos.x + j, pos.y + i);
-				if(walkable(possiblePos)) {
-					possibleMovements.push_back(possiblePos);
-				}
 
-				auto occupied = occupancy.find(possiblePos);
-				if(occupied != occupancy.end()) {
-					Predator* pred = dynamic_cast<Predator*>(occupied->second);
-					if(pred && (*pred).isAlive()) {
-						preds.push_back(possiblePos);
-					}
-				}
-				
-			}
+	// The world's cells go through these, which read the dense grids of a bounded
+	// world and leave chunked worlds to the functions below, out of the way of the
+	// bounded world's hot loops.
+	uint32_t terrainColorAt(olc::vi2d cell) {
+		return chunks ? chunkedColorAt(cell) : terrainColors[cell];
+	}
+
+	landType landAt(olc::vi2d cell) { return chunks ? chunkedLandAt(cell) : land[cell]; }
+
+	uint8_t landNeighboursAt(olc::vi2d cell) { return chunks ? chunkedLandNeighboursAt(cell) : landNeighbours[cell]; }
+
+	// In a chunked world the cells of unloaded chunks are worked out from the noise,
+	// which only reads, so like the rest of these it's safe from several threads.
+	uint32_t chunkedColorAt(olc::vi2d cell) {
+		if(const ChunkedWorld::Chunk* chunk = chunks->find(cell)) return chunk->colors[ChunkedWorld::localOf(cell)];
+		olc::Pixel color;
+		classifyTerrain(noiseHeight(cell.x, cell.y), [&]() { return beachRandom(cell); }, color);
+		return packColor(color);
+	}
+
+	landType chunkedLandAt(olc::vi2d cell) {
+		if(const ChunkedWorld::Chunk* chunk = chunks->find(cell)) return chunk->land[ChunkedWorld::localOf(cell)];
+		olc::Pixel color;
+		return classifyTerrain(noiseHeight(cell.x, cell.y), [&]() { return beachRandom(cell); }, color);
+	}
+
+	uint8_t chunkedLandNeighboursAt(olc::vi2d cell) {
+		if(const ChunkedWorld::Chunk* chunk = chunks->find(cell)) return chunk->landNeighbours[ChunkedWorld::localOf(cell)];
+		uint8_t mask = 0;
+		for(int k = 0; k < 8; k++) {
+			if(chunkedLandAt(olc::vi2d(cell.x + NEIGHBOURS[k].dx, cell.y + NEIGHBOURS[k].dy)) != landType::OCEAN) mask |= 1 << k;
 		}
+		return mask;
+	}
+
+	uint32_t occupantAt(olc::vi2d cell) { return chunks ? chunks->occupantAt(cell) : occupancy.get(cell); }
+
+	// a chunked world loads the cell's chunk first
+	void occupy(olc::vi2d cell, uint32_t entry) {
+		if(chunks) chunks->occupy(cell, entry);
+		else occupancy.set(cell, entry);
+	}
+
+	void vacate(olc::vi2d cell, uint32_t entry) {
+		if(chunks) chunks->vacate(cell, entry);
+		else occupancy.release(cell, entry);
+	}
+
+	uint8_t predatorStepsAt(olc::vi2d cell) { return chunks ? sparseField.stepsAt(cell) : predatorField.stepsAt(cell); }
+
+	uint16_t predatorDistanceAt(olc::vi2d cell) { return chunks ? sparseField.distanceAt(cell) : predatorField.distanceAt(cell); }
+	
+	// only reads the world, so it can run on several preys at once as long as each thread brings its own rng
+	olc::vi2d avoidPredators(olc::vi2d pos, olc::vi2d prevPos, olc::Pixel color, AgentRng& rng) {
+		MoveCandidates possibleMovements(pos, freeNeighbours(pos), false);
 
 		if(possibleMovements.empty()) {return pos;}
 		if(possibleMovements.size() == 1) {return possibleMovements[0];}
 
-		if(preds.size() == 0) {
-			//std::vector<int> colorDiffs;
-			std::uniform_real_distribution<> wander(0.0f, 1.0f);
-			if(wander(generator) <= 0.15) {
-				std::uniform_int_distribution<> randMove(0, possibleMovements.size() - 1);
-				return possibleMovements[randMove(generator)]; 
+		if(predatorStepsAt(pos) > params.preyVision) {
+			if(rng.uniform01() <= 0.15) {
+				return possibleMovements[rng.uniformInt(0, possibleMovements.size() - 1)]; 
 			}
+			uint32_t cellColors[8];
+			int colorDiffs[8];
+			for(int i=0; i<possibleMovements.size(); i++) {
+				cellColors[i] = terrainColorAt(possibleMovements[i]);
+			}
+			packedColorDiffs(packColor(color), cellColors, colorDiffs, possibleMovements.size());
+
 			int best = 0;
 			int bestDiff = std::numeric_limits<int>::max();
 			for(int i=0; i<possibleMovements.size(); i++) {
 				olc::vi2d possiblePos = possibleMovements[i];
-				std::uniform_int_distribution<> randomness(-15, 15);
-				int diffColor = abs(colorDiff(terrainSprite->GetPixel(possiblePos.x, possiblePos.y), color) + randomness(generator));
+				int diffColor = abs(colorDiffs[i] + rng.uniformInt(-15, 15));
 				//std::cout << prevPos.x << " " << prevPos.y << std::endl;
 				if(diffColor < bestDiff && (possiblePos.x != prevPos.x || possiblePos.y != prevPos.y)) {
 					bestDiff = diffColor;
@@ -705,15 +2932,11 @@ protected:
 			return possibleMovements[best];
 		}
 
+		// a predator is in sight, so go down the field: the move that ends furthest from its nearest predator
 		int best = 0;
 		int bestDist = 0;
 		for(int i=0; i<possibleMovements.size(); i++) {
-			int smallestDist = std::numeric_limits<int>::max();
-			for(const auto& pred: preds) {
-				if(distSquared(pred, possibleMovements[i]) < smallestDist) {
-					smallestDist = distSquared(pred, possibleMovements[i]);
-				}
-			}
+			int smallestDist = predatorDistanceAt(possibleMovements[i]);
 			if(smallestDist > bestDist) {
 				best = i;
 				bestDist = smallestDist;
@@ -723,250 +2946,411 @@ protected:
 		return possibleMovements[best];
 	}
 	
-	olc::vi2d moveRandom(olc::vi2d pos, bool isPrey=false) {
-		std::vector<olc::vi2d> possibleMovements;
+	olc::vi2d moveRandom(olc::vi2d pos, AgentRng& rng, bool isPrey=false) {
+		MoveCandidates possibleMovements(pos, isPrey ? freeNeighbours(pos) : huntableNeighbours(pos), walkable(pos, !isPrey));
 
-		for(int i=-1; i<=1; i++) {
-			for(int j=-1; j<=1; j++) {
-				if(walkable(olc::vi2d(pos.x + i, pos.y + j), !isPrey)) {
-					possibleMovements.push_back(olc::vi2d(pos.x + i, pos.y + j));
-				}
+		if (possibleMovements.empty()) return pos;
+
+		return possibleMovements[rng.uniformInt(0, possibleMovements.size() - 1)];
+	}
+	
+	// neighbours of a world cell that are land and empty, as a NEIGHBOURS mask
+	uint8_t freeNeighbours(olc::vi2d cell) {
+		uint8_t mask = landNeighboursAt(cell);
+		uint8_t occupied = 0;
+		for(int k = 0; k < 8; k++) {
+			if((mask & (1 << k)) && occupantAt(olc::vi2d(cell.x + NEIGHBOURS[k].dx, cell.y + NEIGHBOURS[k].dy)) != OccupancyGrid::EMPTY) {
+				occupied |= 1 << k;
 			}
 		}
+		return mask & ~occupied;
+	}
 
-		if (possibleMovements.empty()) return pos;
-
-		if(isPrey) {
-			// move based on color
-			std::uniform_int_distribution<> randMove(0, possibleMovements.size() - 1);
-			return possibleMovements[randMove(generator)];
-		} else {
-			std::uniform_int_distribution<> randMove(0, possibleMovements.size() - 1);
-			return possibleMovements[randMove(generator)];
+	// neighbours of a world cell a predator can step to: land that's empty or holds a live prey
+	uint8_t huntableNeighbours(olc::vi2d cell) {
+		uint8_t mask = landNeighboursAt(cell);
+		uint8_t blocked = 0;
+		for(int k = 0; k < 8; k++) {
+			if(!(mask & (1 << k))) continue;
+			uint32_t entry = occupantAt(olc::vi2d(cell.x + NEIGHBOURS[k].dx, cell.y + NEIGHBOURS[k].dy));
+			if(entry != OccupancyGrid::EMPTY && (OccupancyGrid::isPredator(entry) || !preys.alive[OccupancyGrid::indexOf(entry)])) {
+				blocked |= 1 << k;
+			}
 		}
+		return mask & ~blocked;
 	}
-	
+
+	// in a bounded world the cell must be in the world or next to it, where the ocean border is
 	bool walkable(olc::vi2d cell, bool forPred=false) {
-		if (cell.y < 0 || cell.y >= (int)land[0].size() || cell.x < 0 || cell.x >= (int)land.size() || land[cell.x][cell.y] == landType::OCEAN) {
+		if (landAt(cell) == landType::OCEAN) {
 			return false;
 		}
 
+		uint32_t entry = occupantAt(cell);
 		if(forPred) {
-			auto occupied = occupancy.find(cell);
-			if(occupied != occupancy.end()) {
-				Prey* prey = dynamic_cast<Prey*>(occupied->second);
+			if(entry != OccupancyGrid::EMPTY) {
+				std::optional<Prey> prey = preyAt(cell);
 				return prey && (*prey).isAlive();
 			}
 			return true;
 		}
-		return occupancy.find(cell) == occupancy.end();
+		return entry == OccupancyGrid::EMPTY;
 	}
 
-	void cleanCollections(bool clearPreds, bool clearPreys, bool doBoth=false) {
-		if(clearPreds && clearPreys && doBoth) {
-			for(auto it = occupancy.begin(); it != occupancy.end();) {
-				if(!it->second->isAlive()) {
-					it = occupancy.erase(it);
-				} else {
-					++it;
-				}
+	template <typename Agent>
+	uint32_t entryOf(Agent& agent) { return OccupancyGrid::encode(agent.getIndex(), Agent::SPECIES); }
+
+	// the prey standing on the cell, if the cell holds one
+	std::optional<Prey> preyAt(olc::vi2d cell) {
+		uint32_t entry = occupantAt(cell);
+		if(entry == OccupancyGrid::EMPTY || OccupancyGrid::isPredator(entry)) return std::nullopt;
+		return Prey(preys, OccupancyGrid::indexOf(entry));
+	}
+
+	// swap-removes every dead agent of a store, moving the grid entry of the
+	// agent that takes its place along with it
+	template <typename Store>
+	void compact(Store& store) {
+		for(size_t i = 0; i < store.size();) {
+			if(store.alive[i]) {
+				++i;
+				continue;
 			}
+			vacate(store.pos[i], OccupancyGrid::encode(i, Store::SPECIES));
+			size_t last = store.size() - 1;
+			if(i != last && occupantAt(store.pos[last]) == OccupancyGrid::encode(last, Store::SPECIES)) {
+				occupy(store.pos[last], OccupancyGrid::encode(i, Store::SPECIES));
+			}
+			store.swapRemove(i);
 		}
+	}
+
+	void cleanCollections(bool clearPreds, bool clearPreys) {
+		ScopedTimer timer("cleanCollections");
 		if(clearPreds) {
-			for (auto it = predators.begin(); it != predators.end();) {
-    			if (!(*(*it)).isAlive()) {
-        			occupancy.erase((*it)->getPos());
-        			it = predators.erase(it); // returns next iterator
-				} else {
-       				++it;
-    			}
-			}
+			compact(predators);
 		}
 
-		
 		if(clearPreys) {
-			for (auto it = preys.begin(); it != preys.end();) {
-    			if (!(*(*it)).isAlive()) {
-        			occupancy.erase((*it)->getPos());
-        			it = preys.erase(it); // returns next iterator
-				} else {
-       				++it;
-    			}
-			}
+			compact(preys);
 		}
-		
 	}
 
+	// fills the grid from scratch, only needed after agents are placed in bulk
 	void rebuildOccupancy() {
-		occupancy.clear();
+		ScopedTimer timer("rebuildOccupancy");
+		if(chunks) chunks->clearOccupancy();
+		else occupancy.reset(world_width, world_height);
 
-		for(const auto& preyPtr: preys) {
-			Prey& prey = *preyPtr;
-			if(prey.isAlive()) {
-				occupancy.insert_or_assign(prey.getPos(), &prey);
+		for(size_t i = 0; i < preys.size(); i++) {
+			if(preys.alive[i]) {
+				occupy(preys.pos[i], OccupancyGrid::encode(i, Species::PREY));
 			}
 		}
 
-		for(const auto& predator: predators) {
-			Predator& pred = *predator;
-			if(pred.isAlive()) {
-			occupancy.insert_or_assign(pred.getPos(), &pred);
+		for(size_t i = 0; i < predators.size(); i++) {
+			if(predators.alive[i]) {
+				occupy(predators.pos[i], OccupancyGrid::encode(i, Species::PREDATOR));
 			}
 		}
 	}
 	
-	olc::Pixel addColorVariance(olc::Pixel color, int strength) {
-		std::uniform_int_distribution<> colorVariance(-strength, strength);
-		int r = std::clamp(color.r + colorVariance(generator), 0, 255);
-		int g = std::clamp(color.g + colorVariance(generator), 0, 255);
-		int b = std::clamp(color.b + colorVariance(generator), 0, 255);
+	olc::Pixel addColorVariance(olc::Pixel color, int strength, AgentRng& rng) {
+		int r = std::clamp(color.r + rng.uniformInt(-strength, strength), 0, 255);
+		int g = std::clamp(color.g + rng.uniformInt(-strength, strength), 0, 255);
+		int b = std::clamp(color.b + rng.uniformInt(-strength, strength), 0, 255);
 		return olc::Pixel(r, g, b);
 	}
+
+	uint64_t newAgentId() { return nextAgentId++; }
+
+	// the generator for one agent's decision in the current tick
+	AgentRng rngFor(uint64_t agentId, RngPurpose purpose) { return AgentRng(seed, ticks, agentId, purpose); }
 	
-	void reproduce(olc::vi2d pos, olc::Pixel color=olc::Pixel(255, 0, 0), bool forPred=true) {
-		std::vector<olc::vi2d> possibleMovements;
-		for(int i=-1; i<=1; i++) {
-			for(int j=-1; j<=1; j++) {
-				if(walkable(olc::vi2d(pos.x + j, pos.y + i))) {
-					possibleMovements.push_back(olc::vi2d(pos.x + i, pos.y + j));
-				}
-			}
-		}
+	void reproduce(olc::vi2d pos, AgentRng& rng, olc::Pixel color=olc::Pixel(255, 0, 0), bool forPred=true) {
+		MoveCandidates possibleMovements(pos, freeNeighbours(pos), walkable(pos));
 
 		if(possibleMovements.empty()) {return;}
 
 		if(forPred) {
-			std::uniform_int_distribution reproRand(1, 3);
-			int reproTimes = reproRand(generator);
+			int reproTimes = rng.uniformInt(1, 3);
 			if(possibleMovements.size() < reproTimes) {reproTimes = possibleMovements.size();}
 			for(int i=0; i<reproTimes; i++) {
-				std::uniform_int_distribution<> randMove(0, possibleMovements.size() - 1);
-				olc::vi2d reproPos = possibleMovements[randMove(generator)];
-				auto babyPred = std::make_unique<Predator>(reproPos, color);
-
-				Predator* babyPtr = babyPred.get();
-
-				newPredators.insert(std::move(babyPred));
-				occupancy.insert_or_assign(reproPos, babyPtr);
+				olc::vi2d reproPos = possibleMovements[rng.uniformInt(0, possibleMovements.size() - 1)];
+				size_t baby = predators.add(newAgentId(), reproPos, color);
+				occupy(reproPos, OccupancyGrid::encode(baby, Species::PREDATOR));
 			}
 		} else {
-			std::uniform_int_distribution reproRand(1, 5);
-			int reproTimes = reproRand(generator);
+			int reproTimes = rng.uniformInt(1, 5);
 			if(possibleMovements.size() < reproTimes) {reproTimes = possibleMovements.size();}
 			for(int i=0; i<reproTimes; i++) {
-				std::uniform_int_distribution<> randMove(0, possibleMovements.size() - 1);
-				int randIndex = randMove(generator);
+				int randIndex = rng.uniformInt(0, possibleMovements.size() - 1);
 				olc::vi2d reproPos = possibleMovements[randIndex];
-				possibleMovements.erase(possibleMovements.begin() + randIndex);
-				auto babyPrey = std::make_unique<Prey>(reproPos, addColorVariance(color, 70));
+				possibleMovements.erase(randIndex);
+				size_t baby = preys.add(newAgentId(), reproPos, addColorVariance(color, 70, rng));
+				occupy(reproPos, OccupancyGrid::encode(baby, Species::PREY));
+			}
+		}
+	}
+	
+	// Looks over every cell in a predator's sight for the prey that stands out the
+	// most against the ground it's on, as long as that's by more than 50. Ties go
+	// to the first one in row order.
+	bool spotPrey(olc::vi2d center, olc::vi2d& target) {
+		int bestDiff = 50;
+		bool spotted = false;
+		for(const SightOffset& offset: PREDATOR_SIGHT) {
+			olc::vi2d cell(center.x + offset.dx, center.y + offset.dy);
+			uint32_t entry = occupantAt(cell);
+			if(entry == OccupancyGrid::EMPTY || OccupancyGrid::isPredator(entry)) continue;
+			size_t preyIndex = OccupancyGrid::indexOf(entry);
+			if(!preys.alive[preyIndex]) continue;
+			int colorDifference = packedColorDiff(packColor(preys.color[preyIndex]), terrainColorAt(cell));
+			if(colorDifference > bestDiff) {
+				bestDiff = colorDifference;
+				target = cell;
+				spotted = true;
+			}
+		}
+		return spotted;
+	}
+
+	void updatePredators() {
+		ScopedTimer timer("updatePredators");
+		// newborns are appended behind the current predators and first move next tick
+		size_t count = predators.size();
+		predators.age(0, count);
+		for(size_t index = 0; index < count; index++) {
+			Predator pred(predators, index);
+			int x = pred.getX();
+			int y = pred.getY();
+			if(!pred.isAlive()) {continue;}
+			AgentRng rng = rngFor(pred.getId(), RngPurpose::PREDATOR_MOVE);
+			olc::vi2d target;
+			bool spotted = spotPrey(pred.getPos(), target);
+
+			vacate(pred.getPos(), entryOf(pred));
+			if(!spotted) {
+				pred.move(moveRandom(pred.getPos(), rng, false));
+			} else {
+				if(rng.uniform01() <= 0.07) {
+					pred.move(target);
+				} else {
+					pred.move(stepTowords(olc::vi2d(x, y), target));
+				}
+			}
+			std::optional<Prey> prey = preyAt(pred.getPos());
+			if(prey && (*prey).isAlive()) {
+				pred.eat();
+				(*prey).die();
+			}
+			
+			occupy(pred.getPos(), entryOf(pred));
+
+			if(pred.canReproduce()) {
+				AgentRng reproRng = rngFor(pred.getId(), RngPurpose::PREDATOR_REPRODUCE);
+				reproduce(pred.getPos(), reproRng, pred.getColor(), true);
+				pred.reproduced();
+			}
+		}
+	}
+
+	void updatePreys() {
+		ScopedTimer timer("updatePreys");
+		// predators don't move while the preys do, so one field serves the whole phase;
+		// it reaches one step past the preys' vision to cover the cells they can move to
+		{
+			ScopedTimer timer("predatorField");
+			if(chunks) sparseField.build(predators, [this](olc::vi2d cell) { return landAt(cell) != landType::OCEAN; }, params.preyVision + 1);
+			else predatorField.build(predators, land, params.preyVision + 1);
+		}
+
+		if(workers) {
+			updatePreysParallel();
+			return;
+		}
+
+		// newborns are appended behind the current preys and first move next tick
+		size_t count = preys.size();
+		preys.age(0, count);
+		for(size_t index = 0; index < count; index++) {
+			Prey prey(preys, index);
+			int x = prey.getX();
+			int y = prey.getY();
+			if(!prey.isAlive()) {continue;}
+
+			AgentRng rng = rngFor(prey.getId(), RngPurpose::PREY_MOVE);
+			vacate(prey.getPos(), entryOf(prey));
+			prey.move(avoidPredators(prey.getPos(), prey.getPrevPos(), prey.getColor(), rng));
+			occupy(prey.getPos(), entryOf(prey));
+
+			if(prey.canReproduce()) {
+				AgentRng reproRng = rngFor(prey.getId(), RngPurpose::PREY_REPRODUCE);
+				reproduce(prey.getPos(), reproRng, prey.getColor(), false);
+				prey.reproduced();
+			}
+		}
+		cleanCollections(false, true);
+	}
+
+	// Every prey first picks a target cell against the occupancy as it was at the
+	// start of the phase, on the worker threads. The moves are then applied in
+	// index order, so when two preys want the same cell the lower index gets it
+	// and the other one stays put. Reproduction runs last, serially.
+	void updatePreysParallel() {
+		size_t count = preys.size();
+		// sized for every prey slot, so it only grows with the store
+		preyIntents.reserve(preys.capacity());
+		preyIntents.resize(count);
+
+		workers->parallelFor(count, [this](size_t begin, size_t end, int /*worker*/) {
+			ScopedTimer timer("preyIntents");
+			preys.age(begin, end);
+			for(size_t index = begin; index < end; index++) {
+				Prey prey(preys, index);
+				AgentRng rng = rngFor(prey.getId(), RngPurpose::PREY_MOVE);
+				preyIntents[index] = prey.isAlive() ? avoidPredators(prey.getPos(), prey.getPrevPos(), prey.getColor(), rng) : prey.getPos();
+			}
+		});
+
+		for(size_t index = 0; index < count; index++) {
+			Prey prey(preys, index);
+			if(!prey.isAlive()) {continue;}
+			olc::vi2d target = preyIntents[index];
+			if(target != prey.getPos() && occupantAt(target) != OccupancyGrid::EMPTY) {
+				// taken by a lower index this tick
+				target = prey.getPos();
+			}
+			vacate(prey.getPos(), entryOf(prey));
+			prey.move(target);
+			occupy(prey.getPos(), entryOf(prey));
+		}
+
+		for(size_t index = 0; index < count; index++) {
+			Prey prey(preys, index);
+			if(!prey.isAlive()) {continue;}
+			if(prey.canReproduce()) {
+				AgentRng reproRng = rngFor(prey.getId(), RngPurpose::PREY_REPRODUCE);
+				reproduce(prey.getPos(), reproRng, prey.getColor(), false);
+				prey.reproduced();
+			}
+		}
+		cleanCollections(false, true);
+	}
+};
+
+// dumps the recorded phase timings as a Chrome trace and a percentile table on stderr
+void writeProfile(const std::string& path) {
+	Profiler& profiler = Profiler::instance();
+	if(!profiler.writeChromeTrace(path)) {
+		std::cerr << "can't write " << path << std::endl;
+	}
+	fflush(stdout);
+	profiler.printSummary(stderr);
+}
+
+class SparseEncodedLifeSim : public olc::PixelGameEngine
+{
+public:
+	SparseEncodedLifeSim()
+	{
+		sAppName = "A Mediumly Sized Predator and Prey Simulation";
+		getDesktopResolution();
+	}
+
+	int getScreenWidth() { return screen_width; }
+
+	int getScreenHeight() { return screen_height; }
+
+protected:
+	std::unique_ptr<Simulation> sim;
+	olc::TransformedView tv;
+	olc::UI_CONTAINER myUI;
+
+	std::unique_ptr<olc::Decal> terrainDecal;
 
-				Prey* babyPtr = babyPrey.get();
+	std::chrono::system_clock::time_point currTime = std::chrono::system_clock::now();
+	std::chrono::system_clock::time_point prevTime = std::chrono::system_clock::now();
+
+	int screen_width = 0;
+	int screen_height = 0;
+	// in cells, or 0 to fit the world to the screen
+	int world_width = 0;
+	int world_height = 0;
+	bool terrainDisplayed = false;
+	bool paused = true;
+
+	int FPS = 3;
+
+protected:
+	bool OnUserCreate() override
+	{
+
+		tv.Initialise(GetScreenSize());
+		// 137 w
+		// 77 h
+		tv.SetWorldScale({10.0f, 10.0f});
+		// myUI.ToggleDEBUGMODE();
 
-				newPreys.insert(std::move(babyPrey));
-				occupancy.insert_or_assign(reproPos, babyPtr);
-			}
+		if (world_width == 0 || world_height == 0)
+		{
+			world_width = std::ceil(static_cast<float>(screen_width) / 10);
+			world_height = std::ceil(static_cast<float>(screen_height) / 10);
 		}
-	}
-	
-	void updatePredators() {
-		for(const auto& predator: predators) {
-			Predator& pred = *predator;
-			int x = pred.getX();
-			int y = pred.getY();
-			const int RADIUS = pred.RADIUS;
-			std::vector<std::array<int, 3>> listPreys;
-			pred.update();
-			if(!pred.isAlive()) {continue;}
-			for(int i=y-RADIUS; i<=y+RADIUS; i++) {
-				for(int j=x-RADIUS; j<=x+RADIUS; j++) {
-					int dx = j-x;
-					int dy = i-y;
-					if(dx*dx + dy*dy <= RADIUS*RADIUS+3) {
-						auto cell = occupancy.find(olc::vi2d(j, i));
-						if(cell != occupancy.end()) {
-							Prey* prey = dynamic_cast<Prey*>(cell->second);
-							if(prey && (*prey).isAlive()) {
-								int colorDifference = colorDiff((*prey).getColor(), terrainSprite->GetPixel((*prey).getX(), (*prey).getY()));
-								if(colorDifference > 50) {
-									listPreys.push_back(std::array<int, 3>{
-										(*prey).getX(), 
-										(*prey).getY(), 
-										colorDifference});
-								}
-							}
-						}
-					}
-				}
-			}
+		sim = std::make_unique<Simulation>(world_width, world_height, randomSeed());
+		sim->setTerrainCache(terrainCache);
+		sim->generate();
+		terrainDecal.reset(new olc::Decal(sim->getTerrainSprite()));
+		displayTerrain();
 
-			occupancy.erase(pred.getPos());
-			if(listPreys.size() == 0) {
-				pred.move(moveRandom(pred.getPos(), false));
-			} else {
-				std::sort(listPreys.begin(), listPreys.end(), 
-					[](const std::array<int, 3>& a, const std::array<int, 3>& b) {
-						return a.back() > b.back(); // Use .back() to access the last element
-					});
-				if(listPreys.size() != 0) {
-					std::uniform_real_distribution<> jump(0.0f, 1.0f);
-					if(jump(generator) <= 0.07) {
-						pred.move(olc::vi2d(listPreys[0][0], listPreys[0][1]));
-					} else {
-						pred.move(stepTowords(olc::vi2d(x, y), olc::vi2d(listPreys[0][0], listPreys[0][1])));
-					}
-				}
-			}
-			auto cell = occupancy.find(pred.getPos());
-			if(cell != occupancy.end()) {
-				Prey* prey = dynamic_cast<Prey*>(cell->second);
-				if(prey && (*prey).isAlive()) {
-					pred.eat();
-					(*prey).die();
-				}
-			}
-			
-			occupancy.insert_or_assign(pred.getPos(), &pred);
+		myUI.addNewButton(UIStyle::UI_RED, olc::Key::Q, false, "EXIT", screen_width - 40, 0, 40, 20, "EXIT");
+		// myUI.addNewDropDown(UI_BLACK, UI_BLACK, screen_width - 15, 20, 15, "<", "FIRST,SECOND,EXIT", "CMD_1,CMD_2,EXIT");
 
-			if(pred.canReproduce()) {reproduce(pred.getPos(), pred.getColor(), true); pred.reproduced();}
-		}
-		predators.merge(newPredators);
-		newPredators.clear();
+		return true;
 	}
 
-	void updatePreys() {
-		for(const auto& preyptr: preys) {
-			Prey& prey = *preyptr;
-			int x = prey.getX();
-			int y = prey.getY();
-			prey.update();
-			if(!prey.isAlive()) {continue;}
-
-			occupancy.erase(prey.getPos());
-			prey.move(avoidPredators(prey.getPos(), prey.getPrevPos(), prey.getColor()));
-			occupancy.insert_or_assign(prey.getPos(), &prey);
+	void displayTerrain(bool usingOld = false)
+	{
+		ScopedTimer timer("displayTerrain");
+		if (!usingOld)
+		{
+			if (!terrainDecal)
+				return;
 
-			if(prey.canReproduce()) {reproduce(prey.getPos(), prey.getColor(), false); prey.reproduced();}
+			tv.DrawDecal({0, 0}, terrainDecal.get(), {1.0f, 1.0f});
+		}
+		else
+		{
+			const Grid2D<float>& terrain = sim->getTerrain();
+			int rows = sim->getWorldWidth();
+			int columns = sim->getWorldHeight();
+			for (int i = 0; i < rows; i++)
+			{
+				for (int j = 0; j < columns; j++)
+				{
+					int luminosity = std::clamp(static_cast<int>(std::abs(terrain(i, j)) * 255), 0, 255);
+					tv.FillRectDecal(olc::vi2d(i, j), olc::vi2d(1, 1), olc::Pixel(luminosity, luminosity, luminosity));
+				}
+			}
 		}
-		preys.merge(newPreys);
-		newPreys.clear();
-		cleanCollections(false, true);
 	}
 
 	void drawAnimals() {
-		for(const auto& preyPtr: preys) {
-			Prey& prey = *preyPtr;
-			if(prey.isAlive()) {
-				if (tv.IsRectVisible(prey.getPos(), olc::vi2d(1, 1))) {
-					tv.FillRectDecal(prey.getPos(), olc::vi2d(1, 1), prey.getColor());
+		ScopedTimer timer("drawAnimals");
+		const PreyStore& preys = sim->getPreys();
+		for(size_t i = 0; i < preys.size(); i++) {
+			if(preys.alive[i]) {
+				if (tv.IsRectVisible(preys.pos[i], olc::vi2d(1, 1))) {
+					tv.FillRectDecal(preys.pos[i], olc::vi2d(1, 1), preys.color[i]);
 				}
 			}
 		}
 
-		for(const auto& predator: predators) {
-			Predator& pred = *predator;
-			if(pred.isAlive()) {
-				if (tv.IsRectVisible(pred.getPos(), olc::vi2d(1, 1))) {
-					tv.FillRectDecal(pred.getPos(), olc::vi2d(1, 1), pred.getColor());
+		const PredatorStore& predators = sim->getPredators();
+		for(size_t i = 0; i < predators.size(); i++) {
+			if(predators.alive[i]) {
+				if (tv.IsRectVisible(predators.pos[i], olc::vi2d(1, 1))) {
+					tv.FillRectDecal(predators.pos[i], olc::vi2d(1, 1), predators.color[i]);
 				}
 			}
 		}
@@ -1009,7 +3393,7 @@ protected:
 	
 	void mouseDebug() {
 		auto m = tv.ScreenToWorld(GetMousePos());
-		std::cout << landTypeToString(land[std::floor(m.x)][std::floor(m.y)]) << " (" << m.x << ", " << m.y << ")" << std::endl;
+		std::cout << landTypeToString(sim->getLand(olc::vi2d(std::floor(m.x), std::floor(m.y)))) << " (" << m.x << ", " << m.y << ")" << std::endl;
 	}
 	
 	bool OnUserUpdate(float fElapsedTime) override
@@ -1026,8 +3410,7 @@ protected:
 		}
 
 		if(!paused) {
-			updatePreys();
-			updatePredators();
+			sim->tick();
 		}
 
 		Clear(olc::BLACK);
@@ -1035,15 +3418,20 @@ protected:
 		displayTerrain();
 
 		drawAnimals();
-		cleanCollections(true, true);
-		rebuildOccupancy();
 		
-		DrawStringDecal({2, 2}, "Active: " + std::to_string(preys.size()) + " / " + std::to_string(predators.size()));
+		// formatted into a reused string, so a frame doesn't allocate for it
+		char counts[64];
+		snprintf(counts, sizeof(counts), "Active: %zu / %zu", sim->getPreys().size(), sim->getPredators().size());
+		hudText.assign(counts);
+		DrawStringDecal({2, 2}, hudText);
 		if(paused) {DrawStringDecal({2, 15}, "paused ⏸");}
 		else {DrawStringDecal({2, 15}, "play ▶");}
 
 		// this handles the update of all items
-		myUI.Update(fElapsedTime);
+		{
+			ScopedTimer timer("myUI.Update");
+			myUI.Update(fElapsedTime);
+		}
 		// if any button in the current UI sends the command EXIT, letsd exit
 		if (myUI.hasCommand("EXIT", false))
 			return 0;
@@ -1055,7 +3443,10 @@ protected:
 		// 	myUI.setText(1, ">");
 		// }
 		// This draws all items in the UI
-		myUI.drawUIObjects();
+		{
+			ScopedTimer timer("myUI.drawUIObjects");
+			myUI.drawUIObjects();
+		}
 		// lets also draw all current commands to the screen
 		std::string myOut = myUI.getAllCmds();
 
@@ -1064,9 +3455,30 @@ protected:
 		return !GetKey(olc::Key::ESCAPE).bPressed;
 	}
 
+	bool OnUserDestroy() override
+	{
+		if (!profilePath.empty())
+			writeProfile(profilePath);
+		return true;
+	}
+
+public:
+	// write a trace and a summary of the phase timings to path when the window closes
+	void setProfileOutput(const std::string& path) { profilePath = path; }
+
+	void setWorldSize(int width, int height) { world_width = width; world_height = height; }
+
+	void setTerrainCache(const std::string& dir) { terrainCache = dir; }
+
+protected:
+	std::string profilePath;
+	std::string terrainCache;
+	std::string hudText;
+
 	// Get the horizontal and vertical screen sizes in pixel
 	void getDesktopResolution()
 	{
+#if defined(_WIN32)
 		RECT desktop;
 		// Get a handle to the desktop window
 		const HWND hDesktop = GetDesktopWindow();
@@ -1077,14 +3489,988 @@ protected:
 		// (horizontal, vertical)
 		screen_width = desktop.right;
 		screen_height = desktop.bottom;
+#else
+		screen_width = DEFAULT_SCREEN_WIDTH;
+		screen_height = DEFAULT_SCREEN_HEIGHT;
+#endif
+	}
+};
+
+const size_t DEFAULT_CHUNK_MEMORY_MB = 256;
+
+struct RunOptions {
+	bool headless = false;
+	long long ticks = 1000;
+	// 0 keeps the classic serial prey update; for sweeps it's the number of worlds run at once
+	int threads = 0;
+	uint64_t seed = randomSeed();
+	// world size in cells; the app fits it to the screen when it's not given
+	int worldWidth = 0;
+	int worldHeight = 0;
+	// an unbounded world generated in chunks, with this many MB of chunks kept loaded; 0 for a bounded world
+	size_t chunkMemoryMB = 0;
+	// directory the generated terrain is kept in and loaded back from; empty to generate it every time
+	std::string terrainCache;
+	// checkpoint the world to this file when the run ends, and every checkpointEvery ticks if that's set
+	std::string checkpoint;
+	long long checkpointEvery = 0;
+	// carry on from this checkpoint rather than generating a world
+	std::string restore;
+
+	// parameter sweeps
+	std::string sweep;
+	std::string sweepList;
+	std::string out = "sweep.csv";
+	int runsPerPoint = 1;
+	int sampleEvery = 1;
+	int shardIndex = 0;
+	int shardCount = 1;
+	// run every point's runs as forks of shared worlds warmed up for this many ticks; 0 to start each from scratch
+	long long branchAt = 0;
+
+	// Chrome trace of the phase timings, empty to leave the profiler off
+	std::string profile;
+
+	// fail if a tick allocates once the population stops growing
+	bool checkAllocations = false;
+
+	// benchmarks
+	bool bench = false;
+	std::string benchPresets = "small,screen,4096";
+	std::string benchAgents = "10k,100k,1M";
+};
+
+bool parseArgs(int argc, char* argv[], RunOptions& options) {
+	std::string arg;
+	try {
+		for(int i=1; i<argc; i++) {
+			arg = argv[i];
+			if(arg == "--headless") {
+				options.headless = true;
+			} else if(arg == "--ticks" && i + 1 < argc) {
+				options.ticks = std::stoll(argv[++i]);
+			} else if(arg == "--seed" && i + 1 < argc) {
+				options.seed = std::stoull(argv[++i]);
+			} else if(arg == "--chunked") {
+				if(options.chunkMemoryMB == 0) options.chunkMemoryMB = DEFAULT_CHUNK_MEMORY_MB;
+			} else if(arg == "--chunk-memory" && i + 1 < argc) {
+				options.chunkMemoryMB = std::max(1, std::stoi(argv[++i]));
+			} else if(arg == "--checkpoint" && i + 1 < argc) {
+				options.checkpoint = argv[++i];
+			} else if(arg == "--checkpoint-every" && i + 1 < argc) {
+				options.checkpointEvery = std::max(0LL, std::stoll(argv[++i]));
+			} else if(arg == "--restore" && i + 1 < argc) {
+				options.restore = argv[++i];
+			} else if(arg == "--terrain-cache" && i + 1 < argc) {
+				options.terrainCache = argv[++i];
+			} else if(arg == "--world" && i + 1 < argc) {
+				std::string value = argv[++i];
+				size_t x = value.find('x');
+				if(x != std::string::npos) {
+					options.worldWidth = std::stoi(value.substr(0, x));
+					options.worldHeight = std::stoi(value.substr(x + 1));
+				}
+				if(x == std::string::npos || options.worldWidth < 1 || options.worldHeight < 1) {
+					std::cerr << "--world expects WxH, e.g. 16384x16384" << std::endl;
+					return false;
+				}
+			} else if(arg == "--threads" && i + 1 < argc) {
+				std::string value = argv[++i];
+				options.threads = value == "all" ? std::max(1u, std::thread::hardware_concurrency()) : std::stoi(value);
+			} else if(arg == "--sweep" && i + 1 < argc) {
+				options.sweep = argv[++i];
+			} else if(arg == "--sweep-list" && i + 1 < argc) {
+				options.sweepList = argv[++i];
+			} else if(arg == "--out" && i + 1 < argc) {
+				options.out = argv[++i];
+			} else if(arg == "--runs" && i + 1 < argc) {
+				options.runsPerPoint = std::max(1, std::stoi(argv[++i]));
+			} else if(arg == "--branch-at" && i + 1 < argc) {
+				options.branchAt = std::max(0LL, std::stoll(argv[++i]));
+			} else if(arg == "--sample-every" && i + 1 < argc) {
+				options.sampleEvery = std::max(1, std::stoi(argv[++i]));
+			} else if(arg == "--check-allocations") {
+				options.checkAllocations = true;
+			} else if(arg == "--bench") {
+				options.bench = true;
+			} else if(arg == "--bench-presets" && i + 1 < argc) {
+				options.benchPresets = argv[++i];
+			} else if(arg == "--bench-agents" && i + 1 < argc) {
+				options.benchAgents = argv[++i];
+			} else if(arg == "--profile" && i + 1 < argc) {
+				options.profile = argv[++i];
+			} else if(arg == "--shard" && i + 1 < argc) {
+				std::string value = argv[++i];
+				size_t slash = value.find('/');
+				if(slash == std::string::npos) {
+					std::cerr << "--shard expects i/N" << std::endl;
+					return false;
+				}
+				options.shardIndex = std::stoi(value.substr(0, slash));
+				options.shardCount = std::stoi(value.substr(slash + 1));
+				if(options.shardCount < 1 || options.shardIndex < 0 || options.shardIndex >= options.shardCount) {
+					std::cerr << "--shard expects 0 <= i < N" << std::endl;
+					return false;
+				}
+			} else {
+				std::cerr << "unknown argument: " << arg << std::endl;
+				std::cerr << "usage: " << argv[0] << " [--headless] [--world WxH] [--terrain-cache DIR] [--chunked] [--chunk-memory MB] [--ticks N] [--seed N] [--threads N|all] [--profile FILE] [--check-allocations]" << std::endl;
+				std::cerr << "           [--checkpoint FILE] [--checkpoint-every N] [--restore FILE]" << std::endl;
+				std::cerr << "       " << argv[0] << " --sweep \"name=a,b,c;name=from:to:step\" | --sweep-list FILE" << std::endl;
+				std::cerr << "           [--runs N] [--world WxH] [--terrain-cache DIR] [--ticks N] [--seed N] [--threads N|all] [--sample-every N] [--branch-at N] [--shard i/N] [--out FILE] [--profile FILE]" << std::endl;
+				std::cerr << "       " << argv[0] << " --bench [--bench-presets small,screen,4096,16384] [--bench-agents 10k,100k,1M,10M] [--threads N|all]" << std::endl;
+				return false;
+			}
+		}
+	} catch(const std::exception&) {
+		// std::stoi and friends throw on text that isn't a number or doesn't fit
+		if(arg == "--world") std::cerr << "--world expects WxH, e.g. 16384x16384" << std::endl;
+		else if(arg == "--shard") std::cerr << "--shard expects i/N" << std::endl;
+		else std::cerr << arg << " expects a number" << std::endl;
+		return false;
+	}
+	if(options.checkpointEvery > 0 && options.checkpoint.empty()) {
+		std::cerr << "--checkpoint-every needs --checkpoint FILE to write to" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int worldWidth(const RunOptions& options) { return options.worldWidth ? options.worldWidth : DEFAULT_WORLD_WIDTH; }
+
+int worldHeight(const RunOptions& options) { return options.worldHeight ? options.worldHeight : DEFAULT_WORLD_HEIGHT; }
+
+// the world options that apply before generate()
+void setUpWorld(Simulation& sim, const RunOptions& options) {
+	if(options.chunkMemoryMB > 0) sim.useChunks(options.chunkMemoryMB << 20);
+	sim.setTerrainCache(options.terrainCache);
+}
+
+// steps the simulation at full speed with no window attached and reports the tick rate
+int runHeadless(const RunOptions& options) {
+	// a restored world is the checkpoint's, whatever the options say
+	std::optional<Checkpoint> restored;
+	RunOptions worldOptions = options;
+	if(!options.restore.empty()) {
+		restored.emplace();
+		if(!loadCheckpoint(options.restore, *restored)) {
+			std::cerr << "can't restore " << options.restore << ": missing, damaged or written by another version" << std::endl;
+			return 1;
+		}
+		if(restored->world.chunked && options.chunkMemoryMB == 0) worldOptions.chunkMemoryMB = DEFAULT_CHUNK_MEMORY_MB;
+		if(!restored->world.chunked) worldOptions.chunkMemoryMB = 0;
+	}
+	Simulation sim(restored ? restored->world.width : worldWidth(options), restored ? restored->world.height : worldHeight(options),
+		restored ? restored->world.seed : options.seed, restored ? restored->world.params : SimParams());
+	setUpWorld(sim, worldOptions);
+	sim.setThreadCount(options.threads);
+
+	auto start = std::chrono::steady_clock::now();
+	if(restored) {
+		sim.restore(*restored);
+		restored.reset();
+	} else {
+		sim.generate();
+	}
+	auto generated = std::chrono::steady_clock::now();
+
+	long long firstTick = sim.getTicks();
+	CheckpointWriter checkpoints;
+	long long checkpointTick = -1;
+	auto checkpointFailed = [&]() { std::cerr << "couldn't write the checkpoint of tick " << checkpointTick << " to " << options.checkpoint << std::endl; };
+	for(long long i=0; i<options.ticks; i++) {
+		sim.tick();
+		if(options.checkpointEvery > 0 && sim.getTicks() % options.checkpointEvery == 0) {
+			if(!checkpoints.write(sim.checkpoint(), options.checkpoint)) checkpointFailed();
+			checkpointTick = sim.getTicks();
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	bool checkpointed = true;
+	if(!options.checkpoint.empty()) {
+		// the last tick may already be on its way to disk
+		if(checkpointTick != sim.getTicks()) {
+			if(!checkpoints.write(sim.checkpoint(), options.checkpoint)) checkpointFailed();
+			checkpointTick = sim.getTicks();
+		}
+		checkpointed = checkpoints.wait();
+		if(!checkpointed) checkpointFailed();
+	}
+
+	std::chrono::duration<double> setupTime = generated - start;
+	std::chrono::duration<double> runTime = end - generated;
+	long long ticksRun = sim.getTicks() - firstTick;
+	printf("World: %d x %d, seed: %llu, setup: %.3f s\n", sim.getWorldWidth(), sim.getWorldHeight(), static_cast<unsigned long long>(sim.getSeed()), setupTime.count());
+	if(!options.restore.empty()) printf("Restored: tick %lld from %s\n", firstTick, options.restore.c_str());
+	printf("Ticks: %lld in %.3f s (%.1f ticks/s)\n", ticksRun, runTime.count(), runTime.count() > 0 ? ticksRun / runTime.count() : 0.0);
+	printf("Active: %zu / %zu\n", sim.getPreys().size(), sim.getPredators().size());
+	for(const auto& [name, stats]: {std::make_pair("Prey", sim.getPreys().slotStats()), std::make_pair("Predator", sim.getPredators().slotStats())}) {
+		printf("%s slots: %zu live, %zu peak, %zu capacity; %llu births, %llu recycled slots, %llu deaths\n", name, stats.live, stats.peak, stats.capacity,
+			static_cast<unsigned long long>(stats.births), static_cast<unsigned long long>(stats.recycled), static_cast<unsigned long long>(stats.deaths));
+	}
+	if(sim.isChunked()) {
+		ChunkedWorld::Stats chunks = sim.getChunkStats();
+		printf("Chunks: %zu loaded (%.1f MB), %llu generated, %llu evicted\n", chunks.loaded, chunks.bytes / 1048576.0,
+			static_cast<unsigned long long>(chunks.generated), static_cast<unsigned long long>(chunks.evicted));
+	} else if(!sim.getTerrainCacheFile().empty()) {
+		printf("Terrain: %s %s\n", sim.isTerrainFromCache() ? "mapped from" : "generated and cached in", sim.getTerrainCacheFile().c_str());
+	}
+	if(!options.checkpoint.empty()) {
+		if(!checkpointed) return 1;
+		printf("Checkpoint: tick %lld in %s\n", sim.getTicks(), options.checkpoint.c_str());
+	}
+	return 0;
+}
+
+const int ALLOCATION_WARMUP_TICKS = 50;
+
+// Runs a headless world and counts the heap allocations of every tick after a
+// warm-up. A tick may only allocate while the population is growing: when the
+// prey or predator count reaches a new high or the agent stores have to grow,
+// and on the tick after, when the buffers sized from them catch up.
+int checkAllocations(const RunOptions& options) {
+#ifdef SIM_COUNT_ALLOCATIONS
+	Simulation sim(worldWidth(options), worldHeight(options), options.seed);
+	setUpWorld(sim, options);
+	sim.setThreadCount(options.threads);
+	sim.generate();
+	size_t mostPreys = sim.getPreys().size();
+	size_t mostPredators = sim.getPredators().size();
+
+	long long growingTicks = 0;
+	long long failedTicks = 0;
+	bool grewLastTick = true;
+	for(long long i=-ALLOCATION_WARMUP_TICKS; i<options.ticks; i++) {
+		size_t preyCapacity = sim.getPreys().capacity();
+		size_t predatorCapacity = sim.getPredators().capacity();
+		size_t chunkSlots = sim.getChunkStats().slots;
+		uint64_t before = allocationCount.load();
+		sim.tick();
+		uint64_t allocations = allocationCount.load() - before;
+
+		const PreyStore& preys = sim.getPreys();
+		const PredatorStore& predators = sim.getPredators();
+		bool grew = preys.size() > mostPreys || predators.size() > mostPredators
+			|| preys.capacity() != preyCapacity || predators.capacity() != predatorCapacity || sim.getChunkStats().slots != chunkSlots;
+		mostPreys = std::max(mostPreys, preys.size());
+		mostPredators = std::max(mostPredators, predators.size());
+		bool warmingUp = i < 0;
+		if(grew && !warmingUp) growingTicks++;
+		if(allocations > 0 && !grew && !grewLastTick && !warmingUp) {
+			failedTicks++;
+			fprintf(stderr, "tick %lld allocated %llu times at %zu / %zu agents\n", sim.getTicks(), static_cast<unsigned long long>(allocations),
+				preys.size(), predators.size());
+		}
+		grewLastTick = grew;
+	}
+	printf("Allocations: %lld of %lld ticks allocated in steady state (%lld ticks grew the population)\n", failedTicks, options.ticks, growingTicks);
+	return failedTicks == 0 ? 0 : 1;
+#else
+	(void)options;
+	std::cerr << "--check-allocations needs a build with -DSIM_COUNT_ALLOCATIONS" << std::endl;
+	return 1;
+#endif
+}
+
+// false when the text isn't a number
+bool parseFloat(const std::string& text, float& value) {
+	try {
+		value = std::stof(text);
+		return true;
+	} catch(const std::exception&) {
+		return false;
+	}
+}
+
+// The cartesian product of every value list in a spec like
+// "predPreyR=6,8,10;preyLifespan=20:30:2", where from:to:step is an inclusive range.
+bool expandSweepGrid(const std::string& spec, std::vector<SimParams>& points) {
+	points.assign(1, SimParams());
+	std::stringstream axes(spec);
+	std::string axis;
+	while(std::getline(axes, axis, ';')) {
+		if(axis.empty()) continue;
+		size_t equals = axis.find('=');
+		if(equals == std::string::npos) {
+			std::cerr << "sweep axis without '=': " << axis << std::endl;
+			return false;
+		}
+		std::string name = axis.substr(0, equals);
+		std::string valueList = axis.substr(equals + 1);
+
+		std::vector<float> values;
+		if(std::count(valueList.begin(), valueList.end(), ':') == 2) {
+			size_t first = valueList.find(':');
+			size_t second = valueList.find(':', first + 1);
+			float from, to, step;
+			if(!parseFloat(valueList.substr(0, first), from) || !parseFloat(valueList.substr(first + 1, second - first - 1), to) || !parseFloat(valueList.substr(second + 1), step)) {
+				std::cerr << "sweep range expects from:to:step: " << axis << std::endl;
+				return false;
+			}
+			if(step <= 0) {
+				std::cerr << "sweep range needs a positive step: " << axis << std::endl;
+				return false;
+			}
+			// counted rather than accumulated so float steps don't drop the last value
+			int steps = static_cast<int>(std::floor((to - from) / step + 1e-4f));
+			for(int k=0; k<=steps; k++) {
+				values.push_back(from + k * step);
+			}
+		} else {
+			std::stringstream list(valueList);
+			std::string value;
+			while(std::getline(list, value, ',')) {
+				float number;
+				if(!parseFloat(value, number)) {
+					std::cerr << "sweep value isn't a number: " << axis << std::endl;
+					return false;
+				}
+				values.push_back(number);
+			}
+		}
+
+		std::vector<SimParams> expanded;
+		for(const SimParams& point: points) {
+			for(float value: values) {
+				SimParams next = point;
+				if(!setParam(next, name, value)) {
+					std::cerr << "unknown sweep parameter: " << name << std::endl;
+					return false;
+				}
+				expanded.push_back(next);
+			}
+		}
+		points.swap(expanded);
+	}
+	return true;
+}
+
+// One parameter set per line as "name=value name=value ...", '#' starts a comment line.
+bool loadSweepList(const std::string& path, std::vector<SimParams>& points) {
+	std::ifstream file(path);
+	if(!file) {
+		std::cerr << "can't open sweep list: " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	while(std::getline(file, line)) {
+		if(line.empty() || line[0] == '#') continue;
+		SimParams point;
+		std::stringstream assignments(line);
+		std::string assignment;
+		while(assignments >> assignment) {
+			size_t equals = assignment.find('=');
+			float value;
+			if(equals == std::string::npos || !parseFloat(assignment.substr(equals + 1), value) || !setParam(point, assignment.substr(0, equals), value)) {
+				std::cerr << "bad sweep assignment: " << assignment << std::endl;
+				return false;
+			}
+		}
+		points.push_back(point);
+	}
+	return true;
+}
+
+// Runs every (parameter set, repetition) pair of this shard as its own headless
+// world, several worlds at a time, and writes each run's population per sampled
+// tick to one csv. Run r uses seed + r, so any run can be replayed on its own.
+int runSweep(const RunOptions& options) {
+	std::vector<SimParams> points;
+	if(!options.sweep.empty() && !expandSweepGrid(options.sweep, points)) return 1;
+	if(!options.sweepList.empty() && !loadSweepList(options.sweepList, points)) return 1;
+
+	struct SweepRun {
+		size_t run;
+		size_t point;
+		uint64_t seed;
+		// preys and predators after each sampled tick
+		std::vector<std::array<int, 3>> samples;
+	};
+	// With --branch-at every point's run k forks trunk k, a world of seed --seed + k
+	// run to that tick with the first point's parameters. The points may then only
+	// differ in what acts during ticks.
+	bool branching = options.branchAt > 0;
+	if(branching) {
+		for(const SimParams& p: points) {
+			const SimParams& first = points[0];
+			if(p.roughnessDelta != first.roughnessDelta || p.oceanLim != first.oceanLim || p.beachLim != first.beachLim || p.mountLim != first.mountLim ||
+				p.snowLim != first.snowLim || p.interPredR != first.interPredR || p.interPreyR != first.interPreyR || p.predPreyR != first.predPreyR) {
+				std::cerr << "--branch-at runs share their terrain and starting agents, so only predatorStarvation, preyLifespan and preyVision can be swept" << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	std::vector<SweepRun> runs;
+	size_t totalRuns = points.size() * options.runsPerPoint;
+	for(size_t run = options.shardIndex; run < totalRuns; run += options.shardCount) {
+		size_t trunk = run % options.runsPerPoint;
+		runs.push_back(SweepRun{run, run / options.runsPerPoint, options.seed + (branching ? trunk : run), {}});
+	}
+
+	std::ofstream out(options.out);
+	if(!out) {
+		std::cerr << "can't write " << options.out << std::endl;
+		return 1;
+	}
+
+	int worlds = std::max(1, options.threads);
+	fprintf(stderr, "Sweep: %zu points x %d runs, shard %d/%d runs %zu of them on %d threads\n",
+		points.size(), options.runsPerPoint, options.shardIndex, options.shardCount, runs.size(), worlds);
+
+	// runs sim on to tick `to`, sampling it along the way
+	auto runTo = [&options](Simulation& sim, long long to, std::vector<std::array<int, 3>>& samples) {
+		if(sim.getTicks() == 0) samples.push_back({0, static_cast<int>(sim.getPreys().size()), static_cast<int>(sim.getPredators().size())});
+		while(sim.getTicks() < to) {
+			sim.tick();
+			if(sim.getTicks() % options.sampleEvery == 0) {
+				samples.push_back({static_cast<int>(sim.getTicks()), static_cast<int>(sim.getPreys().size()), static_cast<int>(sim.getPredators().size())});
+			}
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	WorkerPool pool(worlds);
+
+	// the trunks this shard's runs fork, with their samples up to the branch
+	std::vector<std::unique_ptr<Simulation>> trunks(branching ? options.runsPerPoint : 0);
+	std::vector<std::vector<std::array<int, 3>>> trunkSamples(trunks.size());
+	if(branching) {
+		std::vector<size_t> needed;
+		for(const SweepRun& sweepRun: runs) {
+			size_t trunk = sweepRun.run % options.runsPerPoint;
+			if(!trunks[trunk]) {
+				trunks[trunk] = std::make_unique<Simulation>(worldWidth(options), worldHeight(options), sweepRun.seed, points[0]);
+				needed.push_back(trunk);
+			}
+		}
+		std::atomic<size_t> nextTrunk{0};
+		pool.parallelFor(pool.size(), [&](size_t, size_t, int) {
+			for(size_t t = nextTrunk++; t < needed.size(); t = nextTrunk++) {
+				ScopedTimer timer("sweepTrunk");
+				Simulation& trunk = *trunks[needed[t]];
+				setUpWorld(trunk, options);
+				trunk.generate();
+				runTo(trunk, std::min(options.branchAt, options.ticks), trunkSamples[needed[t]]);
+			}
+		});
+		fprintf(stderr, "%zu trunks run to tick %lld\n", needed.size(), std::min(options.branchAt, options.ticks));
+	}
+
+	std::atomic<size_t> nextRun{0};
+	std::atomic<size_t> finished{0};
+	pool.parallelFor(pool.size(), [&](size_t, size_t, int) {
+		for(size_t r = nextRun++; r < runs.size(); r = nextRun++) {
+			ScopedTimer timer("sweepRun");
+			SweepRun& sweepRun = runs[r];
+			sweepRun.samples.reserve(options.ticks / options.sampleEvery + 1);
+			std::unique_ptr<Simulation> sim;
+			if(branching) {
+				size_t trunk = sweepRun.run % options.runsPerPoint;
+				sim = trunks[trunk]->fork(points[sweepRun.point]);
+				sweepRun.samples = trunkSamples[trunk];
+			} else {
+				sim = std::make_unique<Simulation>(worldWidth(options), worldHeight(options), sweepRun.seed, points[sweepRun.point]);
+				setUpWorld(*sim, options);
+				sim->generate();
+			}
+			runTo(*sim, options.ticks, sweepRun.samples);
+			fprintf(stderr, "run %zu done (%zu / %zu)\n", sweepRun.run, ++finished, runs.size());
+		}
+	});
+
+	out << "run,seed,roughnessDelta,oceanLim,beachLim,mountLim,snowLim,interPredR,interPreyR,predPreyR,predatorStarvation,preyLifespan,preyVision,tick,preys,predators\n";
+	for(const SweepRun& sweepRun: runs) {
+		const SimParams& p = points[sweepRun.point];
+		std::stringstream prefix;
+		prefix << sweepRun.run << ',' << sweepRun.seed << ',' << p.roughnessDelta << ',' << p.oceanLim << ',' << p.beachLim << ','
+			<< p.mountLim << ',' << p.snowLim << ',' << p.interPredR << ',' << p.interPreyR << ',' << p.predPreyR << ','
+			<< p.predatorStarvation << ',' << p.preyLifespan << ',' << p.preyVision << ',';
+		for(const auto& sample: sweepRun.samples) {
+			out << prefix.str() << sample[0] << ',' << sample[1] << ',' << sample[2] << '\n';
+		}
+	}
+
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+	fprintf(stderr, "Sweep finished in %.3f s, results in %s\n", runTime.count(), options.out.c_str());
+	return 0;
+}
+
+// A Simulation with its kernels opened up, so the benchmarks can time them one by one
+class BenchWorld : public Simulation
+{
+public:
+	using Simulation::Simulation;
+	using Simulation::generateTerrain;
+	using Simulation::makeTerrain;
+	using Simulation::cacheTerrain;
+	using Simulation::poissonDiskSample;
+	using Simulation::walkable;
+	using Simulation::avoidPredators;
+	using Simulation::spotPrey;
+	using Simulation::reproduce;
+	using Simulation::cleanCollections;
+	using Simulation::rebuildOccupancy;
+
+	struct Snapshot {
+		PredatorStore predators;
+		PreyStore preys;
+		OccupancyGrid occupancy;
+		uint64_t nextAgentId;
+	};
+
+	Snapshot snapshot() { return Snapshot{predators, preys, occupancy, nextAgentId}; }
+
+	void restore(const Snapshot& saved) {
+		predators = saved.predators;
+		preys = saved.preys;
+		occupancy = saved.occupancy;
+		nextAgentId = saved.nextAgentId;
+	}
+
+	PredatorStore& predatorStore() { return predators; }
+
+	PreyStore& preyStore() { return preys; }
+
+	float roughnessDelta() { return params.roughnessDelta; }
+
+	void buildPredatorField() { predatorField.build(predators, land, params.preyVision + 1); }
+
+	void clearAgents() {
+		predators.clear();
+		preys.clear();
+		rebuildOccupancy();
+	}
+
+	// scatters agents over free land cells, one predator for every six preys like
+	// the generated worlds; returns false if the land can't hold that many
+	bool populate(size_t agentCount) {
+		size_t landCells = 0;
+		for(int x = 0; x < world_width; x++) {
+			for(int y = 0; y < world_height; y++) {
+				if(land(x, y) != landType::OCEAN) landCells++;
+			}
+		}
+		if(agentCount > landCells / 2) return false;
+
+		clearAgents();
+		predators.reserve(agentCount / 7 + 1);
+		preys.reserve(agentCount);
+		std::uniform_int_distribution<> randX(0, world_width - 1);
+		std::uniform_int_distribution<> randY(0, world_height - 1);
+		std::uniform_int_distribution<> randColor(0, 255);
+		for(size_t i = 0; i < agentCount; i++) {
+			olc::vi2d cell(randX(generator), randY(generator));
+			while(!walkable(cell)) {
+				cell = olc::vi2d(randX(generator), randY(generator));
+			}
+			if(i % 7 == 0) {
+				occupy(cell, OccupancyGrid::encode(predators.add(newAgentId(), cell, olc::Pixel(255, 0, 0)), Species::PREDATOR));
+			} else {
+				olc::Pixel color(randColor(generator), randColor(generator), randColor(generator));
+				occupy(cell, OccupancyGrid::encode(preys.add(newAgentId(), cell, color), Species::PREY));
+			}
+		}
+		return true;
+	}
+};
+
+struct BenchPreset {
+	const char* name;
+	int width;
+	int height;
+};
+
+// the screen preset is the world the app opens on a 1920x1080 desktop
+const BenchPreset BENCH_PRESETS[] = {
+	{"small", 64, 64},
+	{"screen", 192, 108},
+	{"4096", 4096, 4096},
+	{"16384", 16384, 16384},
+};
+
+const uint64_t BENCH_SEED = 42;
+const int BENCH_REPS = 5;
+
+struct BenchResult {
+	std::string name;
+	size_t opsPerRep = 0;
+	std::vector<double> repNs;
+
+	// a kernel with nothing to work on, e.g. spotPrey in a world without predators, isn't timed
+	bool skipped() const { return opsPerRep == 0; }
+
+	// only for results that weren't skipped
+	double medianNsPerOp() const {
+		std::vector<double> sorted = repNs;
+		std::sort(sorted.begin(), sorted.end());
+		return sorted[sorted.size() / 2] / opsPerRep;
+	}
+
+	double minNsPerOp() const {
+		return *std::min_element(repNs.begin(), repNs.end()) / opsPerRep;
+	}
+};
+
+// keeps the compiler from dropping the results of the timed loops
+volatile uint64_t benchSink = 0;
+
+// times run() BENCH_REPS times, calling setup() untimed before each one
+template <typename Setup, typename Run>
+BenchResult measure(const std::string& name, size_t opsPerRep, Setup setup, Run run) {
+	BenchResult result;
+	result.name = name;
+	result.opsPerRep = opsPerRep;
+	if(result.skipped()) {
+		fprintf(stderr, "  %-20s      skipped, nothing to time\n", name.c_str());
+		return result;
+	}
+	for(int rep = 0; rep < BENCH_REPS; rep++) {
+		setup();
+		auto start = std::chrono::steady_clock::now();
+		run();
+		auto end = std::chrono::steady_clock::now();
+		result.repNs.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+	}
+	fprintf(stderr, "  %-20s %12.1f ns/op\n", name.c_str(), result.medianNsPerOp());
+	return result;
+}
+
+std::vector<BenchResult> benchKernels(BenchWorld& world) {
+	std::vector<BenchResult> results;
+	auto noSetup = []() {};
+	BenchWorld::Snapshot generated = world.snapshot();
+	auto restore = [&]() { world.restore(generated); };
+
+	// cells around and just outside the world, the way moves probe them
+	std::mt19937 cellGenerator(BENCH_SEED);
+	std::uniform_int_distribution<> randX(-1, world.getWorldWidth());
+	std::uniform_int_distribution<> randY(-1, world.getWorldHeight());
+	std::vector<olc::vi2d> cells(1 << 20);
+	for(olc::vi2d& cell: cells) {
+		cell = olc::vi2d(randX(cellGenerator), randY(cellGenerator));
+	}
+	results.push_back(measure("walkable", cells.size(), noSetup, [&]() {
+		uint64_t free = 0;
+		for(const olc::vi2d& cell: cells) free += world.walkable(cell);
+		benchSink = benchSink + free;
+	}));
+
+	PreyStore& preys = world.preyStore();
+	PredatorStore& predators = world.predatorStore();
+	world.buildPredatorField();
+	results.push_back(measure("avoidPredators", preys.size(), noSetup, [&]() {
+		uint64_t sum = 0;
+		for(size_t i = 0; i < preys.size(); i++) {
+			AgentRng rng(BENCH_SEED, 0, preys.id[i], RngPurpose::PREY_MOVE);
+			olc::vi2d move = world.avoidPredators(preys.pos[i], preys.prevPos[i], preys.color[i], rng);
+			sum += move.x + move.y;
+		}
+		benchSink = benchSink + sum;
+	}));
+
+	results.push_back(measure("spotPrey", predators.size(), noSetup, [&]() {
+		uint64_t spotted = 0;
+		olc::vi2d target;
+		for(size_t i = 0; i < predators.size(); i++) {
+			spotted += world.spotPrey(predators.pos[i], target);
+		}
+		benchSink = benchSink + spotted;
+	}));
+
+	size_t preyCount = preys.size();
+	results.push_back(measure("reproduce/prey", preyCount, restore, [&]() {
+		for(size_t i = 0; i < preyCount; i++) {
+			AgentRng rng(BENCH_SEED, 0, preys.id[i], RngPurpose::PREY_REPRODUCE);
+			world.reproduce(preys.pos[i], rng, preys.color[i], false);
+		}
+	}));
+
+	size_t predatorCount = predators.size();
+	results.push_back(measure("reproduce/predator", predatorCount, restore, [&]() {
+		for(size_t i = 0; i < predatorCount; i++) {
+			AgentRng rng(BENCH_SEED, 0, predators.id[i], RngPurpose::PREDATOR_REPRODUCE);
+			world.reproduce(predators.pos[i], rng, predators.color[i], true);
+		}
+	}));
+
+	// an eighth of the agents died this tick, about what a running world sees
+	results.push_back(measure("cleanCollections", preyCount + predatorCount, [&]() {
+		restore();
+		for(size_t i = 0; i < preys.size(); i += 8) preys.alive[i] = 0;
+		for(size_t i = 0; i < predators.size(); i += 8) predators.alive[i] = 0;
+	}, [&]() {
+		world.cleanCollections(true, true);
+	}));
+
+	results.push_back(measure("rebuildOccupancy", preyCount + predatorCount, restore, [&]() {
+		world.rebuildOccupancy();
+	}));
+
+	// the agents' cells in a sparse map, the way an unbounded world would keep them
+	std::vector<olc::vi2d> agentCells(predators.pos.begin(), predators.pos.end());
+	agentCells.insert(agentCells.end(), preys.pos.begin(), preys.pos.end());
+	FlatCellMap<uint32_t> cellMap;
+	cellMap.reserve(agentCells.size());
+	results.push_back(measure("flatCellMap/insert", agentCells.size(), [&]() {
+		cellMap.clear();
+	}, [&]() {
+		for(size_t i = 0; i < agentCells.size(); i++) cellMap[agentCells[i]] = static_cast<uint32_t>(i);
+	}));
+
+	results.push_back(measure("flatCellMap/find", agentCells.size(), noSetup, [&]() {
+		uint64_t sum = 0;
+		for(const olc::vi2d& cell: agentCells) sum += *cellMap.find(cell);
+		benchSink = benchSink + sum;
+	}));
+
+	// these regenerate the world, so they go last
+	size_t cellCount = static_cast<size_t>(world.getWorldWidth()) * world.getWorldHeight();
+	results.push_back(measure("makeTerrain", cellCount, noSetup, [&]() {
+		world.makeTerrain(world.roughnessDelta());
+	}));
+
+	results.push_back(measure("cacheTerrain", cellCount, noSetup, [&]() {
+		world.cacheTerrain();
+	}));
+
+	results.push_back(measure("poissonDiskSample", cellCount, [&]() {
+		world.clearAgents();
+	}, [&]() {
+		world.poissonDiskSample();
+	}));
+
+	return results;
+}
+
+// the cell hash this repo used to have, shifting y by 4 bits rather than 32;
+// kept only to compare against
+struct LegacyCellHash
+{
+	std::size_t operator()(const olc::vi2d &v) const
+	{
+		return int64_t(v.y << sizeof(int32_t) | v.x);
+	}
+};
+
+struct HashBenchResult {
+	std::string distribution;
+	std::string hash;
+	ProbeStats stats;
+};
+
+template <typename Hash>
+ProbeStats probeStatsFor(const std::vector<olc::vi2d>& cells) {
+	FlatCellMap<uint32_t, Hash> map;
+	map.reserve(cells.size());
+	for(size_t i = 0; i < cells.size(); i++) map[cells[i]] = static_cast<uint32_t>(i);
+	return map.probeStats();
+}
+
+// Probe lengths of a FlatCellMap holding the agents' cells, with the mixed hash
+// and the legacy one, on the world as sampled and again after it has run a while
+// and the agents have bunched up. Big worlds are thinned to an even spread of
+// agents, as the legacy hash piles them into so few runs that filling its map
+// takes quadratic time.
+std::vector<HashBenchResult> benchHashing(BenchWorld& world) {
+	const int HASH_BENCH_TICKS = 50;
+	const size_t HASH_BENCH_MAX_CELLS = 1 << 16;
+	std::vector<HashBenchResult> results;
+	for(const char* distribution: {"sampled", "ticked"}) {
+		if(std::string(distribution) == "ticked") {
+			for(int i = 0; i < HASH_BENCH_TICKS; i++) world.tick();
+		}
+		std::vector<olc::vi2d> agentCells(world.getPredators().pos.begin(), world.getPredators().pos.end());
+		agentCells.insert(agentCells.end(), world.getPreys().pos.begin(), world.getPreys().pos.end());
+		size_t stride = agentCells.size() / HASH_BENCH_MAX_CELLS + 1;
+		std::vector<olc::vi2d> cells;
+		for(size_t i = 0; i < agentCells.size(); i += stride) cells.push_back(agentCells[i]);
+		if(cells.empty()) {
+			fprintf(stderr, "  %-8s skipped, no agents\n", distribution);
+			continue;
+		}
+		results.push_back(HashBenchResult{distribution, "mix64", probeStatsFor<HASH_OLC_VI2D>(cells)});
+		results.push_back(HashBenchResult{distribution, "legacy", probeStatsFor<LegacyCellHash>(cells)});
+	}
+	for(const HashBenchResult& result: results) {
+		fprintf(stderr, "  %-8s %-7s %9zu cells  mean probe %8.2f  max %zu\n", result.distribution.c_str(), result.hash.c_str(),
+			result.stats.entries, result.stats.meanProbe, result.stats.maxProbe);
 	}
+	return results;
+}
+
+struct TickBenchResult {
+	size_t agents;
+	int side;
+	long long ticks;
+	double seconds;
+	size_t finalAgents;
 };
 
-int main()
+// steps a world holding the given number of agents for about two seconds
+TickBenchResult benchTicks(size_t agents, int threads) {
+	// about one agent for every five cells, so there's room to move and breed;
+	// the world grows until its land can take them all
+	int side = static_cast<int>(std::ceil(std::sqrt(agents * 5.0)));
+	std::unique_ptr<BenchWorld> generated;
+	for(int attempt = 0; attempt < 8 && !generated; attempt++, side = side * 5 / 4) {
+		generated = std::make_unique<BenchWorld>(side, side, BENCH_SEED);
+		generated->setThreadCount(threads);
+		generated->generateTerrain();
+		if(!generated->populate(agents)) generated.reset();
+	}
+	if(!generated) {
+		std::cerr << "not enough land for " << agents << " agents" << std::endl;
+		return TickBenchResult{agents, side, 0, 0.0, 0};
+	}
+	BenchWorld& world = *generated;
+	world.tick();
+
+	long long ticks = 0;
+	auto start = std::chrono::steady_clock::now();
+	std::chrono::duration<double> elapsed(0);
+	while(ticks < 3 || (elapsed.count() < 2.0 && ticks < 1000)) {
+		world.tick();
+		ticks++;
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	size_t finalAgents = world.getPreys().size() + world.getPredators().size();
+	fprintf(stderr, "  %zu agents: %.2f ticks/s\n", agents, ticks / elapsed.count());
+	return TickBenchResult{agents, world.getWorldWidth(), ticks, elapsed.count(), finalAgents};
+}
+
+// splits a comma list, e.g. "small,screen" or "10k,1M"
+std::vector<std::string> splitList(const std::string& list) {
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while(std::getline(stream, item, ',')) {
+		if(!item.empty()) items.push_back(item);
+	}
+	return items;
+}
+
+// 10000, 10k or 10M, false for anything else
+bool parseCount(const std::string& text, size_t& count) {
+	size_t end = 0;
+	double value;
+	try {
+		value = std::stod(text, &end);
+	} catch(const std::exception&) {
+		return false;
+	}
+	std::string suffix = text.substr(end);
+	if(suffix == "k" || suffix == "K") value *= 1e3;
+	else if(suffix == "m" || suffix == "M") value *= 1e6;
+	else if(!suffix.empty()) return false;
+	if(value < 0) return false;
+	count = static_cast<size_t>(value);
+	return true;
+}
+
+// Times every kernel on each world preset and full ticks at each agent count,
+// with fixed seeds, and writes the results as JSON to stdout.
+int runBench(const RunOptions& options) {
+	std::vector<const BenchPreset*> presets;
+	for(const std::string& name: splitList(options.benchPresets)) {
+		const BenchPreset* found = nullptr;
+		for(const BenchPreset& preset: BENCH_PRESETS) {
+			if(name == preset.name) found = &preset;
+		}
+		if(!found) {
+			std::cerr << "unknown bench preset: " << name << std::endl;
+			return 1;
+		}
+		presets.push_back(found);
+	}
+	std::vector<size_t> agentCounts;
+	for(const std::string& text: splitList(options.benchAgents)) {
+		size_t count;
+		if(!parseCount(text, count)) {
+			std::cerr << "bad bench agent count: " << text << std::endl;
+			return 1;
+		}
+		agentCounts.push_back(count);
+	}
+
+	std::stringstream json;
+	json << "{\n\"seed\": " << BENCH_SEED << ",\n\"reps\": " << BENCH_REPS << ",\n\"threads\": " << options.threads << ",\n\"kernels\": [";
+	bool first = true;
+	std::stringstream hashJson;
+	bool firstHash = true;
+	for(const BenchPreset* preset: presets) {
+		fprintf(stderr, "%s (%d x %d)\n", preset->name, preset->width, preset->height);
+		BenchWorld world(preset->width, preset->height, BENCH_SEED);
+		world.setThreadCount(options.threads);
+		world.generate();
+		size_t preys = world.getPreys().size();
+		size_t predators = world.getPredators().size();
+		if(preys == 0 || predators == 0) {
+			fprintf(stderr, "  starts with %zu preys and %zu predators, so the kernels without agents to work on are skipped\n", preys, predators);
+		}
+		for(const BenchResult& result: benchKernels(world)) {
+			json << (first ? "\n" : ",\n");
+			json << "{\"preset\": \"" << preset->name << "\", \"width\": " << preset->width << ", \"height\": " << preset->height
+				<< ", \"preys\": " << preys << ", \"predators\": " << predators
+				<< ", \"name\": \"" << result.name << "\", \"opsPerRep\": " << result.opsPerRep;
+			if(result.skipped()) {
+				json << ", \"skipped\": true}";
+			} else {
+				json << ", \"medianNsPerOp\": " << result.medianNsPerOp() << ", \"minNsPerOp\": " << result.minNsPerOp()
+					<< ", \"opsPerSecond\": " << 1e9 / std::max(result.medianNsPerOp(), 1e-3) << "}";
+			}
+			first = false;
+		}
+		for(const HashBenchResult& result: benchHashing(world)) {
+			hashJson << (firstHash ? "\n" : ",\n");
+			hashJson << "{\"preset\": \"" << preset->name << "\", \"distribution\": \"" << result.distribution
+				<< "\", \"hash\": \"" << result.hash << "\", \"entries\": " << result.stats.entries
+				<< ", \"capacity\": " << result.stats.capacity << ", \"meanProbe\": " << result.stats.meanProbe
+				<< ", \"maxProbe\": " << result.stats.maxProbe << "}";
+			firstHash = false;
+		}
+	}
+	json << "\n],\n\"hashing\": [" << hashJson.str();
+	json << "\n],\n\"ticks\": [";
+	first = true;
+	for(size_t agents: agentCounts) {
+		TickBenchResult result = benchTicks(agents, options.threads);
+		double ticksPerSecond = result.seconds > 0 ? result.ticks / result.seconds : 0.0;
+		json << (first ? "\n" : ",\n");
+		json << "{\"agents\": " << result.agents << ", \"width\": " << result.side << ", \"height\": " << result.side
+			<< ", \"ticks\": " << result.ticks << ", \"seconds\": " << result.seconds
+			<< ", \"ticksPerSecond\": " << ticksPerSecond << ", \"agentUpdatesPerSecond\": " << ticksPerSecond * result.agents
+			<< ", \"finalAgents\": " << result.finalAgents << "}";
+		first = false;
+	}
+	json << "\n]\n}\n";
+	std::cout << json.str();
+	return 0;
+}
+
+int main(int argc, char* argv[])
 {
+	RunOptions options;
+	if (!parseArgs(argc, argv, options))
+		return 1;
+
+	if (!options.profile.empty())
+		Profiler::instance().enable();
+
+	bool sweep = !options.sweep.empty() || !options.sweepList.empty();
+	if (options.bench || sweep || options.headless) {
+		int result = options.bench ? runBench(options) : sweep ? runSweep(options) : options.checkAllocations ? checkAllocations(options) : runHeadless(options);
+		if (!options.profile.empty())
+			writeProfile(options.profile);
+		return result;
+	}
+
 	SparseEncodedLifeSim demo;
+	demo.setProfileOutput(options.profile);
+	demo.setWorldSize(options.worldWidth, options.worldHeight);
+	demo.setTerrainCache(options.terrainCache);
 	if (demo.Construct(/*1280, 960*/ demo.getScreenWidth(), demo.getScreenHeight(), 1, 1, true))
 		demo.Start();
 
 	return 0;
-}
\ No newline at end of file
+}